@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <fstream>
+#include "fems.h"
+#include "mesh/generator.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Микробенчмарки вычислительных ядер: функции формы, построение функций формы КЭ,
+// вычисление выражений программы (TNode::value), ансамблирование, карта связей сетки,
+// учет граничных условий и решение СЛАУ. Каждое ядро замеряется отдельно на сетке
+// куба из n^3 шестигранников (по 6 тетраэдров) с прогревом и повторениями,
+// результат - строка JSON на каждое ядро и размер задачи
+//
+// fems-bench [--sizes 4,8,16] [--repeat 5] [--warmup 1] [--filter имя] [--program файл.prg]
+//-----------------------------------------------------------------------
+class TBench
+{
+    using T = TShape<TShape3d4>;
+private:
+    unsigned repeat = 5;
+    unsigned warmup = 1;
+    string filter;
+    list<string> program{ "argument x, y, z",
+                          "result u, v, w",
+                          "constant E = 203200, m = 0.27, G = E / (2 + 2 * m), L = 2 * m * G / (1 - 2 * m)",
+                          "function Exx, Eyy, Ezz, Exy, Exz, Eyz, Sxx, Syy, Szz, Sxy, Sxz, Syz",
+                          "load X = 0, Y = 0, Z = 0.5",
+                          "functional W",
+                          "Exx = diff(u, x)",
+                          "Eyy = diff(v, y)",
+                          "Ezz = diff(w, z)",
+                          "Exy = diff(u, y) + diff(v, x)",
+                          "Exz = diff(u, z) + diff(w, x)",
+                          "Eyz = diff(v, z) + diff(w, y)",
+                          "Sxx = 2 * G * Exx + L * (Exx + Eyy + Ezz)",
+                          "Syy = 2 * G * Eyy + L * (Exx + Eyy + Ezz)",
+                          "Szz = 2 * G * Ezz + L * (Exx + Eyy + Ezz)",
+                          "Sxy = G * Exy",
+                          "Sxz = G * Exz",
+                          "Syz = G * Eyz",
+                          "W = 0.5 * integral(Sxx var Exx + Syy var Eyy + Szz var Ezz + Sxy var Exy + Sxz var Exz + Syz var Eyz) - integral(X var u + Y var w + Z var w)",
+                          "u(z == 0) = 0",
+                          "v(z == 0) = 0",
+                          "w(z == 0) = 0" };
+    ostream &out;
+    // Результат, который не должен быть отброшен оптимизатором
+    volatile double sink = 0;
+    // Замер ядра run: prepare выполняется перед каждым повторением и во время не входит
+    void measure(const string &name, unsigned size, size_t items, function<void(void)> run, function<void(void)> prepare = nullptr)
+    {
+        vector<double> time;
+        double sum = 0;
+
+        if (filter.length() and name.find(filter) == string::npos)
+            return;
+        for (auto i = 0u; i < warmup + repeat; i++)
+        {
+            chrono::steady_clock::time_point start;
+
+            if (prepare)
+                prepare();
+            start = chrono::steady_clock::now();
+            run();
+            if (i >= warmup)
+                time.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        sort(time.begin(), time.end());
+        for (auto it: time)
+            sum += it;
+        out.precision(6);
+        out << "{ \"name\": \"" << name << "\", \"size\": " << size << ", \"items\": " << items << ", \"repeat\": " << repeat
+            << ", \"min\": " << time.front() << ", \"median\": " << time[time.size() / 2] << ", \"mean\": " << sum / time.size()
+            << ", \"max\": " << time.back() << ", \"items_per_sec\": " << items / time[time.size() / 2] << " }" << endl;
+    }
+public:
+    TBench(ostream &o) noexcept : out{o} {}
+    ~TBench(void) noexcept = default;
+    void set_repeat(unsigned r, unsigned w) noexcept
+    {
+        repeat = max(1u, r);
+        warmup = w;
+    }
+    void set_filter(const string &f)
+    {
+        filter = f;
+    }
+    // Операторы программы из файла (директивы препроцессора пропускаются)
+    void set_program(const string &name)
+    {
+        ifstream in(name);
+        string str;
+
+        if (not in.is_open())
+            throw TError(Message::ReadFile);
+        program.clear();
+        while (getline(in, str))
+            if (str.find_first_not_of(" \t\r") not_eq string::npos and str[str.find_first_not_of(" \t")] not_eq '#')
+                program.push_back(str);
+    }
+    void run(unsigned n)
+    {
+        TFEM<TEigenSolver> fem;
+        TMesh &mesh = fem.mesh;
+        TParser<T> parser;
+        TShapeBatch<T> batch;
+        TMeshGenerator generator;
+        vector<double> res;
+        vector<vector<T>> shape;
+        vector<array<double, 3>> coord;
+        vector<matrix<double>> lm;
+        size_t count;
+        // Локальные матрицы всех КЭ (вычисление функционала программы)
+        auto evaluate = [&]
+        {
+            for (auto i = 0u; i < count; i += batch.width())
+            {
+                batch.pack(mesh, i);
+                batch.evaluate();
+                for (auto l = 0; l < batch.size(); l++)
+                {
+                    parser.set_data(batch.shape(l));
+                    lm[batch.index(l)] = parser.run(batch.coord(l), batch.get_jacobian(l)).asMatrix();
+                }
+            }
+        };
+        auto assemble = [&]
+        {
+            fem.solver.clearMatrix();
+            for (auto i = 0u; i < count; i++)
+                fem.ansamble_local_matrix(lm[i], i);
+        };
+
+        generator.set_mesh("fe3d4", { n, n, n });
+        generator.create();
+        fem.set_mesh("fe3d4", generator.get_x(), generator.get_fe(), generator.get_be());
+        parser.set_program(program);
+        count = mesh.get_fe_count();
+        for (auto i = 0u; i < count; i++)
+        {
+            shape.push_back(mesh.get_shape<T>(i));
+            for (auto k = 0; k < T::size(); k++)
+                coord.push_back(mesh.get_coord_fe(i, size_t(k)));
+        }
+
+        measure("shape_value", n, count * T::size() * T::size(), [&]
+        {
+            double sum = 0;
+
+            for (auto i = 0u; i < count; i++)
+                for (auto k = 0; k < T::size(); k++)
+                    for (auto v = 0; v < T::size(); v++)
+                        sum += shape[i][k].value(coord[i * T::size() + v]);
+            sink = sum;
+        });
+        measure("shape_diff", n, count * T::size() * 3, [&]
+        {
+            double sum = 0;
+
+            for (auto i = 0u; i < count; i++)
+                for (auto k = 0; k < T::size(); k++)
+                    for (auto d: { Direct::X, Direct::Y, Direct::Z })
+                        sum += shape[i][k].diff(d).value(coord[i * T::size()]);
+            sink = sum;
+        });
+        measure("mesh_get_shape", n, count, [&]
+        {
+            for (auto i = 0u; i < count; i++)
+                sink = mesh.get_shape<T>(i)[0].value(coord[i * T::size()]);
+        });
+        measure("mesh_map", n, count, [&] { mesh.create_mesh_map(); });
+        lm.resize(count);
+        evaluate();
+        measure("node_value", n, count, evaluate);
+        fem.solver.setup(mesh);
+        measure("ansamble_local_matrix", n, count, [&] { assemble(); });
+        measure("boundary_conditions", n, mesh.get_x().size1(), [&] { fem.use_boundary_condition(parser); }, assemble);
+        // Умножение матрицы на вектор (k = 1) и на блок из 4 векторов: скалярное CSC и блочное хранение
+        assemble();
+        fem.use_boundary_condition(parser);
+        {
+            auto &csc = fem.solver.getMatrix();
+            TBlockMatrix<double> bsr;
+            vector<double> x(size_t(csc.rows()), 1.0),
+                           y(x.size()),
+                           xk(x.size() * 4, 1.0),
+                           yk(xk.size());
+
+            bsr.create(mesh.get_x().size1(), unsigned(mesh.get_freedom()), true, [&mesh](size_t i) -> const vector<TIndex>& { return mesh.get_mesh_map(i); });
+            bsr.from_csc(csc);
+            measure("spmv_csc", n, size_t(csc.nonZeros()), [&] { fem.solver.product(csc, x, y); sink = y[0]; });
+            measure("spmv_bsr", n, size_t(csc.nonZeros()), [&] { bsr.multiply(x.data(), y.data()); sink = y[0]; });
+            measure("spmm_csc", n, size_t(csc.nonZeros()) * 4, [&]
+            {
+                Map<MatrixXd> mx(xk.data(), csc.rows(), 4),
+                              my(yk.data(), csc.rows(), 4);
+
+                my.noalias() = csc.selfadjointView<Upper>() * mx;
+                sink = yk[0];
+            });
+            measure("spmm_bsr", n, size_t(csc.nonZeros()) * 4, [&] { bsr.multiply(xk.data(), yk.data(), 4); sink = yk[0]; });
+        }
+        measure("solve", n, mesh.get_x().size1() * size_t(mesh.get_freedom()), [&] { fem.solve_equations(res); }, [&]
+        {
+            assemble();
+            fem.use_boundary_condition(parser);
+        });
+    }
+};
+
+int main(int argc, char **argv)
+{
+    // Сообщения модели (параметры сетки) не должны смешиваться с результатами замеров
+    ostream out(cout.rdbuf());
+    TBench bench(out);
+    vector<unsigned> sizes{ 4, 8, 16 };
+    unsigned repeat = 5,
+             warmup = 1;
+
+    TProgress::set_quiet(true);
+    cout.rdbuf(nullptr);
+    try
+    {
+        for (auto i = 1; i < argc; i++)
+        {
+            string arg = argv[i];
+
+            if (i + 1 == argc)
+                throw TError(Message::Syntax);
+            if (arg == "--sizes")
+            {
+                stringstream ss(argv[++i]);
+                string str;
+
+                sizes.clear();
+                while (getline(ss, str, ','))
+                    sizes.push_back(unsigned(max(1, stoi(str))));
+            }
+            else if (arg == "--repeat")
+                repeat = unsigned(max(1, stoi(argv[++i])));
+            else if (arg == "--warmup")
+                warmup = unsigned(max(0, stoi(argv[++i])));
+            else if (arg == "--filter")
+                bench.set_filter(argv[++i]);
+            else if (arg == "--program")
+                bench.set_program(argv[++i]);
+            else
+                throw TError(Message::Syntax);
+        }
+        bench.set_repeat(repeat, warmup);
+        for (auto n: sizes)
+            bench.run(n);
+    }
+    catch (TError &e)
+    {
+        cerr << e.say() << endl;
+        return 1;
+    }
+    catch (exception&)
+    {
+        cerr << say_message(Message::Syntax) << endl;
+        return 1;
+    }
+    return 0;
+}
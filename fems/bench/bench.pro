@@ -0,0 +1,11 @@
+# Микробенчмарки вычислительных ядер FEM Solver (см. bench.cpp)
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+TARGET = fems-bench
+
+include(../core/core.pri)
+
+SOURCES += \
+        bench.cpp
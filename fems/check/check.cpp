@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "fems.h"
+#include "file/codec.h"
+#include "analyse/resfile.h"
+#include "solver/blockmatrix.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Проверки ядер, результат которых нельзя сравнить с выходными файлами расчета:
+// сжатие блоков (TBlockCodec) - восстановление случайных, несжимаемых данных и
+// длинных повторов, отказ на усеченных и поврежденных блоках, поблочное сжатие
+// полей .bres (result_compress); блочная матрица (TBlockMatrix) - преобразование
+// в CSC и обратно и умножение на векторы в сравнении с Eigen.
+// Для каждой проверки выводится строка "ok|FAILED имя", код возврата 1 - есть ошибки
+//
+// fems-check [--seed n]
+//-----------------------------------------------------------------------
+class TCheck
+{
+private:
+    mt19937_64 generator;
+    ostream &out;
+    unsigned failed = 0;
+    void check(const string &name, bool is_ok)
+    {
+        out << (is_ok ? "ok " : "FAILED ") << name << endl;
+        if (not is_ok)
+            failed++;
+    }
+    vector<uint8_t> compress(const vector<uint8_t> &src)
+    {
+        vector<uint8_t> ret(TBlockCodec::bound(src.size()));
+
+        ret.resize(TBlockCodec::compress(src.data(), src.size(), ret.data()));
+        return ret;
+    }
+    bool round_trip(const vector<uint8_t> &src)
+    {
+        vector<uint8_t> packed = compress(src),
+                        res(src.size());
+
+        return packed.size() <= TBlockCodec::bound(src.size()) and TBlockCodec::decompress(packed.data(), packed.size(), res.data(), res.size()) and
+               res == src;
+    }
+    vector<uint8_t> random_bytes(size_t size)
+    {
+        vector<uint8_t> ret(size);
+
+        for (auto &it: ret)
+            it = uint8_t(generator());
+        return ret;
+    }
+    // Данные из фрагментов, повторяющих предыдущие участки на расстоянии до 64 Кб (совпадения LZ4)
+    vector<uint8_t> repeated_bytes(size_t size)
+    {
+        vector<uint8_t> ret = random_bytes(min(size, size_t(64)));
+
+        while (ret.size() < size)
+        {
+            size_t offset = 1 + generator() % min(ret.size(), size_t(65535)),
+                   len = min(size - ret.size(), size_t(4 + generator() % 300));
+
+            for (size_t i = 0; i < len; i++)
+                ret.push_back(ret[ret.size() - offset]);
+            if (generator() % 4 == 0)
+                ret.push_back(uint8_t(generator()));
+        }
+        ret.resize(size);
+        return ret;
+    }
+    void check_codec(void)
+    {
+        vector<uint8_t> zeros(1 << 20, 0),
+                        data = repeated_bytes(200000),
+                        packed = compress(data),
+                        res(data.size());
+        vector<double> field(3 * result_block_values + 123);
+        bool is_ok = true;
+
+        for (auto size: { 0, 1, 4, 5, 12, 13, 17, 255, 270, 4096, 65536, 65543 })
+            is_ok = is_ok and round_trip(random_bytes(size_t(size))) and round_trip(repeated_bytes(size_t(size)));
+        check("codec_round_trip_random", is_ok);
+        check("codec_incompressible_bound", compress(random_bytes(100000)).size() <= TBlockCodec::bound(100000));
+        // Повтор длиннее 64 Кб (расстояние 1, длина совпадения кодируется цепочкой байтов 255)
+        check("codec_round_trip_long_run", round_trip(zeros) and compress(zeros).size() < zeros.size() / 200);
+        check("codec_round_trip_repeated", round_trip(data) and packed.size() < data.size());
+
+        // Усеченный блок: каждая длина короче полной
+        is_ok = true;
+        for (size_t len = 0; len < packed.size(); len += max(size_t(1), packed.size() / 1000))
+            is_ok = is_ok and not TBlockCodec::decompress(packed.data(), len, res.data(), res.size());
+        for (size_t len = packed.size() - min(packed.size(), size_t(64)); len < packed.size(); len++)
+            is_ok = is_ok and not TBlockCodec::decompress(packed.data(), len, res.data(), res.size());
+        check("codec_truncated", is_ok);
+        // Размер восстановленных данных должен совпадать с заданным
+        check("codec_wrong_size", not TBlockCodec::decompress(packed.data(), packed.size(), res.data(), res.size() - 1) and
+                                  not TBlockCodec::decompress(packed.data(), packed.size(), vector<uint8_t>(res.size() + 1).data(), res.size() + 1));
+        // Ссылка на данные до начала блока и нулевое смещение
+        {
+            const uint8_t before[] = { 0x10, 'a', 0x02, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' },
+                          zero[] = { 0x10, 'a', 0x00, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' },
+                          valid[] = { 0x10, 'a', 0x01, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+            uint8_t dst[10];
+
+            check("codec_invalid_offset", not TBlockCodec::decompress(before, sizeof(before), dst, sizeof(dst)) and
+                                          not TBlockCodec::decompress(zero, sizeof(zero), dst, sizeof(dst)) and
+                                          TBlockCodec::decompress(valid, sizeof(valid), dst, sizeof(dst)) and
+                                          string(reinterpret_cast<char*>(dst), sizeof(dst)) == "aaaaabcdef");
+        }
+        // Поврежденный блок: декодирование не выходит за границы буфера (результат может быть любым)
+        {
+            vector<uint8_t> bad,
+                            guard(res.size() + 64, 0xA5);
+            unsigned rejected = 0;
+
+            is_ok = true;
+            for (auto i = 0; i < 2000; i++)
+            {
+                bad = packed;
+                for (auto k = 1 + generator() % 4; k > 0; k--)
+                    bad[generator() % bad.size()] ^= uint8_t(1 + generator() % 255);
+                fill(guard.begin(), guard.end(), 0xA5);
+                if (not TBlockCodec::decompress(bad.data(), bad.size(), guard.data(), res.size()))
+                    rejected++;
+                is_ok = is_ok and all_of(guard.begin() + ptrdiff_t(res.size()), guard.end(), [](uint8_t v) { return v == 0xA5; });
+            }
+            check("codec_corrupted", is_ok and rejected > 0);
+        }
+
+        // Поля .bres: перестановка байтов и сжатие по блокам, в т.ч. неполный последний блок
+        {
+            vector<uint8_t> table;
+            vector<double> block(result_block_values);
+            vector<float> single(field.size()),
+                          single_block(result_block_values);
+
+            for (auto i = 0u; i < field.size(); i++)
+                single[i] = float(field[i] = sin(double(i) * 1.0E-3) * 1.0E3);
+            is_ok = true;
+            result_compress(field.data(), field.size(), sizeof(double), table);
+            for (uint64_t i = 0; i < result_blocks(field.size()); i++)
+            {
+                uint64_t first = i * result_block_values,
+                         n = min(result_block_values, field.size() - first);
+
+                is_ok = is_ok and result_decompress(table.data(), table.size(), field.size(), sizeof(double), i, block.data()) and
+                        equal(block.begin(), block.begin() + ptrdiff_t(n), field.begin() + ptrdiff_t(first));
+            }
+            is_ok = is_ok and not result_decompress(table.data(), table.size(), field.size(), sizeof(double), result_blocks(field.size()), block.data()) and
+                    not result_decompress(table.data(), sizeof(uint64_t), field.size(), sizeof(double), 0, block.data());
+            result_compress(single.data(), single.size(), sizeof(float), table);
+            for (uint64_t i = 0; i < result_blocks(single.size()); i++)
+            {
+                uint64_t first = i * result_block_values,
+                         n = min(result_block_values, single.size() - first);
+
+                is_ok = is_ok and result_decompress(table.data(), table.size(), single.size(), sizeof(float), i, single_block.data()) and
+                        equal(single_block.begin(), single_block.begin() + ptrdiff_t(n), single.begin() + ptrdiff_t(first));
+            }
+            // Таблица смещений блоков, указывающая за пределы поля
+            memset(table.data() + sizeof(uint64_t), 0xFF, sizeof(uint64_t));
+            is_ok = is_ok and not result_decompress(table.data(), table.size(), single.size(), sizeof(float), 0, single_block.data());
+            check("codec_result_fields", is_ok);
+        }
+    }
+    // Блочная матрица со случайной структурой из nodes узлов в сравнении с матрицей Eigen,
+    // построенной по той же структуре и тем же значениям
+    void check_block(size_t nodes, unsigned freedom, bool is_symmetric)
+    {
+        string name = "block_" + to_string(freedom) + (is_symmetric ? "_upper" : "_full");
+        vector<vector<TIndex>> neighbours(nodes);
+        vector<Triplet<double>> triplets;
+        SparseMatrix<double, ColMajor, TIndex> ref,
+                                            csc;
+        TBlockMatrix<double> block,
+                             copy;
+        size_t n = nodes * freedom;
+        const size_t k = 4;
+        vector<double> x(n * k),
+                       y(n * k);
+        MatrixXd ref_y;
+        bool is_ok = true;
+        auto value = [](size_t i, size_t j) { return 1.0 + double((i * 7919 + j * 104729) % 1000) * 1.0E-3; };
+
+        for (auto i = 0u; i < nodes; i++)
+            for (auto j = i + 1; j < nodes; j++)
+                if (j == i + 1 or generator() % nodes < 4)
+                {
+                    neighbours[i].push_back(TIndex(j));
+                    neighbours[j].push_back(TIndex(i));
+                }
+        for (auto &it: neighbours)
+            sort(it.begin(), it.end());
+        block.create(nodes, freedom, is_symmetric, [&](size_t i) -> const vector<TIndex>& { return neighbours[i]; });
+        copy.create(nodes, freedom, is_symmetric, [&](size_t i) -> const vector<TIndex>& { return neighbours[i]; });
+        for (auto j = 0u; j < nodes; j++)
+        {
+            vector<TIndex> list = neighbours[j];
+
+            list.push_back(TIndex(j));
+            for (auto i: list)
+                for (auto c = 0u; c < freedom; c++)
+                    for (auto r = 0u; r < freedom; r++)
+                    {
+                        size_t row = size_t(i) * freedom + r,
+                               col = j * freedom + c;
+                        // При хранении верхнего треугольника матрица симметрична (сравнение с selfadjointView)
+                        double val = is_symmetric ? value(min(row, col), max(row, col)) : value(row, col);
+
+                        if (is_symmetric and row > col)
+                            continue;
+                        triplets.push_back({ TIndex(row), TIndex(col), val });
+                        if (double *p = block.find(row, col))
+                            *p = val;
+                        else
+                            is_ok = false;
+                    }
+        }
+        ref.resize(TIndex(n), TIndex(n));
+        ref.setFromTriplets(triplets.begin(), triplets.end());
+        check(name + "_find", is_ok and block.nonzeros() == size_t(ref.nonZeros()));
+
+        block.to_csc(csc);
+        check(name + "_to_csc", csc.nonZeros() == ref.nonZeros() and SparseMatrix<double, ColMajor, TIndex>(csc - ref).norm() == 0);
+        is_ok = copy.from_csc(ref);
+        copy.to_csc(csc);
+        check(name + "_from_csc", is_ok and SparseMatrix<double, ColMajor, TIndex>(csc - ref).norm() == 0);
+        // Ненулевой элемент вне структуры матрицы (узел, не смежный с узлом 0)
+        for (auto j = 2u; j < nodes; j++)
+            if (not binary_search(neighbours[0].begin(), neighbours[0].end(), TIndex(j)))
+            {
+                SparseMatrix<double, ColMajor, TIndex> extra = ref;
+
+                extra.coeffRef(0, TIndex(j * freedom)) = 1.0;
+                check(name + "_from_csc_outside", not copy.from_csc(extra));
+                break;
+            }
+
+        for (auto &it: x)
+            it = double(generator() % 2001) * 1.0E-3 - 1.0;
+        for (auto v: { size_t(1), k })
+        {
+            Map<MatrixXd> mx(x.data(), TIndex(n), TIndex(v));
+
+            block.multiply(x.data(), y.data(), v);
+            ref_y = is_symmetric ? MatrixXd(ref.selfadjointView<Upper>() * mx) : MatrixXd(ref * mx);
+            check(name + (v == 1 ? "_spmv" : "_spmm"), (Map<MatrixXd>(y.data(), TIndex(n), TIndex(v)) - ref_y).norm() <= 1.0E-12 * max(1.0, ref_y.norm()));
+        }
+    }
+public:
+    TCheck(ostream &o, uint64_t seed) noexcept : generator{seed}, out{o} {}
+    ~TCheck(void) noexcept = default;
+    unsigned run(void)
+    {
+        check_codec();
+        // Размеры блоков с отдельными ядрами умножения (1, 2, 3, 6) и общий случай (4)
+        for (auto freedom: { 1u, 2u, 3u, 4u, 6u })
+            for (auto is_symmetric: { true, false })
+                check_block(60, freedom, is_symmetric);
+        return failed;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = 1;
+
+    try
+    {
+        for (auto i = 1; i < argc; i++)
+        {
+            if (i + 1 == argc or string(argv[i]) not_eq "--seed")
+                throw TError(Message::Syntax);
+            seed = stoull(argv[++i]);
+        }
+        return TCheck(cout, seed).run() ? 1 : 0;
+    }
+    catch (TError &e)
+    {
+        cerr << e.say() << endl;
+        return 1;
+    }
+    catch (exception&)
+    {
+        cerr << say_message(Message::Syntax) << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,11 @@
+# Проверки сжатия блоков и блочной матрицы FEM Solver (см. check.cpp)
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+TARGET = fems-check
+
+include(../core/core.pri)
+
+SOURCES += \
+        check.cpp
@@ -8,6 +8,18 @@
 #include <vector>
 #include <ctime>
 #include <chrono>
+#include <memory>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include "analyse/resfile.h"
+#include "file/mapfile.h"
+#include "file/textfile.h"
+#include "hash/hash.h"
+#include "mesh/mesh.h"
+#include "mesh/meshfile.h"
+#include "msg/msg.h"
+#include "thread/workers.h"
 
 using namespace std;
 
@@ -28,6 +40,8 @@ public:
         name = r.name;
         time = r.time;
     }
+    TResult(TResult&&) = default;
+    TResult &operator = (TResult&&) = default;
     TResult(vector<double> &res, string fname, double t = 0)
     {
         results = res;
@@ -40,18 +54,19 @@ public:
         name = fname;
         time = t;
     }
+    // Поле, значения которого еще не загружены (см. TResultList::open)
+    TResult(string fname, double t) : name{fname}, time{t} {}
     ~TResult(void) = default;
     bool write(ofstream& out)
     {
         unsigned len = unsigned(results.size());
 
-        out << name.c_str() << endl;
-        out << time << endl;
-        out << len << endl;
+        out << name.c_str() << '\n';
+        out << time << '\n';
+        out << len << '\n';
         if (out.fail())
             return false;
-        for (unsigned i = 0; i < len; i++)
-            out << results[i] << endl;
+        TTextTable::write(out, results.data(), len, 1);
         if (out.fail())
             return false;
         return true;
@@ -81,6 +96,10 @@ public:
     {
         return results;
     }
+    size_t get_size(void) const
+    {
+        return results.size();
+    }
     double &get_results(unsigned i)
     {
         return results[i];
@@ -117,6 +136,108 @@ class TResultList
 private:
     time_t sdt;
     vector<TResult> result;
+    // Двоичный файл результатов, отображенный в память: поля считываются по первому обращению
+    shared_ptr<TMappedFile> file;
+    const TResultHeader *header = nullptr;
+    vector<TResultField> directory;
+    vector<bool> is_loaded;
+    // Каталог открытого файла (от него отсчитывается относительный путь к сетке)
+    string dir;
+    // Значения поля i с номерами [first, first + count) из файла в dst;
+    // из сжатого поля восстанавливаются только содержащие их блоки (параллельно)
+    bool read_range(unsigned i, uint64_t first, uint64_t count, double *dst)
+    {
+        auto &f = directory[i];
+        uint64_t elem = f.type == FieldType::Float64 ? sizeof(double) : sizeof(float),
+                 first_block = first / result_block_values,
+                 blocks;
+        const uint8_t *data = file->at<uint8_t>(f.offset, f.size);
+        vector<thread> pool;
+        atomic<bool> is_ok = true;
+        unsigned workers;
+        auto decompress = [&](uint64_t k)
+        {
+            vector<double> buffer(result_block_values);
+            vector<float> fbuffer(f.type == FieldType::Float32 ? result_block_values : 0);
+
+            for (auto b = first_block + k; b < first_block + blocks and is_ok; b += workers)
+            {
+                uint64_t start = b * result_block_values,
+                         from = max(first, start),
+                         to = min(first + count, start + result_block_values);
+
+                if (not result_decompress(data, f.size, f.count, elem, b, f.type == FieldType::Float64 ? (void*)buffer.data() : (void*)fbuffer.data()))
+                {
+                    is_ok = false;
+                    break;
+                }
+                for (auto j = from; j < to; j++)
+                    dst[j - first] = f.type == FieldType::Float64 ? buffer[j - start] : double(fbuffer[j - start]);
+            }
+        };
+
+        if (not data or first > f.count or count > f.count - first)
+            return false;
+        if (f.codec == FieldCodec::None)
+        {
+            if (f.type == FieldType::Float64)
+            {
+                auto p = file->at<double>(f.offset + first * sizeof(double), count);
+
+                if (not p)
+                    return false;
+                copy(p, p + count, dst);
+            }
+            else
+            {
+                auto p = file->at<float>(f.offset + first * sizeof(float), count);
+
+                if (not p)
+                    return false;
+                copy(p, p + count, dst);
+            }
+            return true;
+        }
+        if (f.codec not_eq FieldCodec::Block)
+            return false;
+        if (count == 0)
+            return true;
+        blocks = (first + count - 1) / result_block_values - first_block + 1;
+        workers = unsigned(min(uint64_t(TWorkers::count()), blocks));
+        for (auto k = 1u; k < workers; k++)
+            pool.push_back(thread(decompress, k));
+        decompress(0);
+        for (auto &it: pool)
+            it.join();
+        return is_ok;
+    }
+    void load(unsigned i)
+    {
+        result[i].get_results().resize(directory[i].count);
+        if (not read_range(i, 0, directory[i].count, result[i].get_results().data()))
+            throw TError(Message::ReadFile);
+        is_loaded[i] = true;
+    }
+    // Загрузка сетки по ссылке с проверкой хеша содержимого ее файла
+    static void load_mesh_ref(TMesh &mesh, const string &dir, string path, uint64_t hash)
+    {
+        THash h;
+
+        if (filesystem::path(path).is_relative())
+            path = (filesystem::path(dir) / path).string();
+        if (not h.add_file(path))
+            throw TError(Message::ReadFile);
+        if (h.value() not_eq hash)
+            throw TError(Message::MeshChanged);
+        mesh.read(path);
+    }
+    void close(void)
+    {
+        file.reset();
+        header = nullptr;
+        directory.clear();
+        is_loaded.clear();
+    }
 public:
     TResultList(void) = default;
     ~TResultList(void) = default;
@@ -136,10 +257,12 @@ public:
     {
         TResult c(res, n, t);
 
-        for (auto &it: result)
-            if (n == it.get_name())
+        for (auto i = 0u; i < result.size(); i++)
+            if (n == result[i].get_name())
             {
-                it = c;
+                result[i] = c;
+                if (i < is_loaded.size())
+                    is_loaded[i] = true;
                 return;
             }
         result.push_back(c);
@@ -148,31 +271,159 @@ public:
     {
         TResult c(res, sz, n, t);
 
-        for (auto &it: result)
-            if (n == it.get_name())
+        for (auto i = 0u; i < result.size(); i++)
+            if (n == result[i].get_name())
             {
-                it = c;
+                result[i] = c;
+                if (i < is_loaded.size())
+                    is_loaded[i] = true;
                 return;
             }
         result.push_back(c);
     }
     TResult &operator [] (unsigned i)
     {
+        if (i < is_loaded.size() and not is_loaded[i])
+            load(i);
         return result[i];
     }
+    // Открытие двоичного файла результатов: считывается только каталог полей
+    bool open(const string &name)
+    {
+        result.clear();
+        close();
+        file = make_shared<TMappedFile>();
+        if (not file->open(name) or not (header = file->at<TResultHeader>(0)) or
+            memcmp(header->signature, result_signature, sizeof(result_signature)) or header->version not_eq result_version or
+            not file->at<TResultField>(header->directory_offset, header->field_count))
+        {
+            close();
+            return false;
+        }
+        dir = filesystem::path(name).parent_path().string();
+        sdt = time_t(header->solution_time);
+        directory.assign(file->at<TResultField>(header->directory_offset, header->field_count),
+                         file->at<TResultField>(header->directory_offset, header->field_count) + header->field_count);
+        for (auto &it: directory)
+        {
+            it.name[sizeof(it.name) - 1] = 0;
+            result.push_back(TResult(it.name, it.time));
+        }
+        is_loaded.assign(directory.size(), false);
+        return true;
+    }
+    // Сетка из двоичного файла результатов (записанная в нем или заданная ссылкой на файл сетки)
+    bool read_mesh(string &type, matrix<double> &x, matrix<TIndex> &fe, matrix<TIndex> &be)
+    {
+        const double *px;
+        const char *pfe,
+                   *pbe;
+        unsigned index_size = header and header->flags & result_index64 ? sizeof(int64_t) : sizeof(int32_t);
+        const TResultMeshRef *ref;
+        const char *path;
+        TMesh mesh;
+
+        if (header and header->flags & result_mesh_ref)
+        {
+            if (not (ref = file->at<TResultMeshRef>(header->x_offset)) or
+                not (path = file->at<char>(header->x_offset + sizeof(TResultMeshRef), size_t(ref->length))))
+                return false;
+            load_mesh_ref(mesh, dir, string(path, size_t(ref->length)), ref->hash);
+            if (mesh.get_x().size1() not_eq size_t(header->nodes) or mesh.get_x().size2() not_eq header->dim or
+                mesh.get_fe_count() not_eq size_t(header->fe_count) or mesh.get_fe().size2() not_eq header->fe_size)
+                throw TError(Message::MeshChanged);
+            type = mesh.get_type_name();
+            mesh.get_x().copy_to(x);
+            mesh.get_fe().copy_to(fe);
+            if (header->be_count)
+                mesh.get_be().copy_to(be);
+            else
+                be.resize(0, header->be_size);
+            return true;
+        }
+        if (not header or not (px = file->at<double>(header->x_offset, size_t(header->nodes * header->dim))) or
+            not (pfe = file->at<char>(header->fe_offset, size_t(header->fe_count * header->fe_size) * index_size)) or
+            not (pbe = file->at<char>(header->be_offset, size_t(header->be_count * header->be_size) * index_size)))
+            return false;
+        type = string(header->fe_type, strnlen(header->fe_type, sizeof(header->fe_type)));
+        x.resize(size_t(header->nodes), header->dim);
+        fe.resize(size_t(header->fe_count), header->fe_size);
+        be.resize(size_t(header->be_count), header->be_size);
+        copy(px, px + header->nodes * header->dim, x.data());
+        // Индексы файла приводятся к разрядности TIndex
+        return TMeshFile::convert(pfe, index_size, fe.size1() * fe.size2(), x.size1(), fe.data()) and
+               TMeshFile::convert(pbe, index_size, be.size1() * be.size2(), x.size1(), be.data());
+    }
+    // Раздел сетки текстового файла результатов ("Mesh" или "MeshRef"); dir - каталог файла
+    bool read_mesh(ifstream &in, TMesh &mesh, const string &dir)
+    {
+        string str,
+               type,
+               path,
+               hash;
+
+        in >> str;
+        if (str == "Mesh")
+            mesh.read(in);
+        else if (str == "MeshRef")
+        {
+            in >> type >> ws;
+            getline(in, path);
+            in >> hash;
+            if (in.fail() or hash.length() not_eq 16)
+                return false;
+            load_mesh_ref(mesh, dir, path, stoull(hash, nullptr, 16));
+            if (mesh.get_type_name() not_eq type)
+                throw TError(Message::MeshChanged);
+        }
+        else
+            return false;
+        return not in.fail();
+    }
+    // Значения поля непосредственно в отображенном файле (только для несжатых полей double)
+    const double *get_data(unsigned i)
+    {
+        if (i >= directory.size() or directory[i].type not_eq FieldType::Float64 or directory[i].codec not_eq FieldCodec::None)
+            return nullptr;
+        return file->at<double>(directory[i].offset, directory[i].count);
+    }
+    // Значения поля i для узлов [first, first + count) без загрузки всего поля
+    bool get_range(unsigned i, uint64_t first, uint64_t count, vector<double> &res)
+    {
+        if (i >= result.size())
+            return false;
+        res.resize(count);
+        if (i >= is_loaded.size() or is_loaded[i])
+        {
+            vector<double> &val = result[i].get_results();
+
+            if (first > val.size() or count > val.size() - first)
+                return false;
+            copy(val.begin() + long(first), val.begin() + long(first + count), res.begin());
+            return true;
+        }
+        return read_range(i, first, count, res.data());
+    }
     bool write(ofstream& out)
     {
         set_current_solution_time();
-        out << "Results" << endl;
-        out << sdt << endl;
-        out << result.size() << endl;
+        out << "Results" << '\n';
+        out << sdt << '\n';
+        out << result.size() << '\n';
         if (out.fail())
             return false;
-        for (auto it: result)
-            if (!it.write(out))
+        for (auto i = 0u; i < result.size(); i++)
+            if (!(*this)[i].write(out))
                 return false;
         return !out.fail();
     }
+    void write(TResultFile &out)
+    {
+        set_current_solution_time();
+        for (auto i = 0u; i < result.size(); i++)
+            out.write_result(result[i].get_name(), result[i].get_time(), (*this)[i].get_results());
+        out.close(int64_t(sdt));
+    }
     bool read(ifstream& in)
     {
         string str;
@@ -180,6 +431,7 @@ public:
         TResult c;
 
         result.clear();
+        close();
         in >> str;
         in >> sdt;
         in >> num;
@@ -201,6 +453,7 @@ public:
     void clear(void)
     {
         result.clear();
+        close();
     }
     int index(string n)
     {
@@ -0,0 +1,276 @@
+#ifndef RESFILE_H
+#define RESFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include "matrix/matrix.h"
+#include "matrix/index.h"
+#include "matrix/packed.h"
+#include "file/codec.h"
+#include "thread/workers.h"
+
+using namespace std;
+
+/***************************************************/
+/*          Двоичный файл результатов              */
+/*  заголовок | сетка | поля | каталог полей       */
+/***************************************************/
+constexpr char result_signature[8] = "FEMSRES";
+constexpr uint32_t result_version = 1;
+
+// Флаги заголовка: сетка не записана, а задана ссылкой на исходный файл (см. TResultMeshRef);
+// индексы сетки - int64 (при сборке с 64-битными индексами, см. matrix/index.h)
+constexpr uint32_t result_mesh_ref = 1;
+constexpr uint32_t result_index64 = 2;
+
+// Способ хранения значений поля
+enum class FieldType : uint32_t { Float64 = 0, Float32 = 1 };
+
+// Сжатие значений поля: None - массив значений; Block - блоки по result_block_values значений,
+// каждый из которых сжат независимо (TBlockCodec), перед блоками - таблица их смещений
+// (result_blocks(count) + 1 значений uint64 относительно начала данных поля)
+enum class FieldCodec : uint32_t { None = 0, Block = 1 };
+
+constexpr uint64_t result_block_values = 16384;
+
+inline uint64_t result_blocks(uint64_t count)
+{
+    return (count + result_block_values - 1) / result_block_values;
+}
+
+struct TResultHeader
+{
+    char signature[8];          // "FEMSRES"
+    uint32_t version;
+    uint32_t field_count;
+    int64_t solution_time;
+    uint64_t directory_offset;  // Смещение каталога полей (записывается последним)
+    char fe_type[16];           // Тип КЭ ("fe3d4" и т.п.)
+    uint32_t dim;               // Размерность координат
+    uint32_t fe_size;           // Количество узлов КЭ
+    uint32_t be_size;           // Количество узлов граничного элемента
+    uint32_t flags;
+    int64_t nodes;
+    int64_t fe_count;
+    int64_t be_count;
+    uint64_t x_offset;          // Координаты (double, nodes * dim) или ссылка на сетку
+    uint64_t fe_offset;         // Связность КЭ (int32 или int64 - см. result_index64, fe_count * fe_size)
+    uint64_t be_offset;         // Граничные элементы (be_count * be_size)
+};
+
+// Элемент каталога полей
+struct TResultField
+{
+    char name[32];
+    double time;
+    uint64_t count;             // Количество значений
+    uint64_t offset;            // Смещение данных в файле
+    uint64_t size;              // Размер данных в байтах
+    FieldType type;
+    FieldCodec codec;
+};
+
+// Сжатие блоков поля (по несколько потоков); data - count значений размером elem байт
+inline void result_compress(const void *data, uint64_t count, uint64_t elem, vector<uint8_t> &res)
+{
+    uint64_t blocks = result_blocks(count);
+    vector<vector<uint8_t>> buffer(blocks);
+    vector<uint64_t> table(blocks + 1);
+    vector<thread> pool;
+    unsigned workers = unsigned(min(uint64_t(TWorkers::count()), blocks));
+    auto compress = [&](unsigned k)
+    {
+        vector<uint8_t> shuffled;
+
+        for (auto i = k; i < blocks; i += workers)
+        {
+            uint64_t n = min(result_block_values, count - i * result_block_values);
+
+            shuffled.resize(n * elem);
+            TBlockCodec::shuffle(static_cast<const uint8_t*>(data) + i * result_block_values * elem, shuffled.data(), n, elem);
+            buffer[i].resize(TBlockCodec::bound(shuffled.size()));
+            buffer[i].resize(TBlockCodec::compress(shuffled.data(), shuffled.size(), buffer[i].data()));
+        }
+    };
+
+    for (auto k = 1u; k < workers; k++)
+        pool.push_back(thread(compress, k));
+    if (workers)
+        compress(0);
+    for (auto &it: pool)
+        it.join();
+    table[0] = (blocks + 1) * sizeof(uint64_t);
+    for (uint64_t i = 0; i < blocks; i++)
+        table[i + 1] = table[i] + buffer[i].size();
+    res.resize(table[blocks]);
+    memcpy(res.data(), table.data(), table.size() * sizeof(uint64_t));
+    for (uint64_t i = 0; i < blocks; i++)
+        memcpy(res.data() + table[i], buffer[i].data(), buffer[i].size());
+}
+
+// Восстановление блока i сжатого поля (size байт по адресу data) в dst; false - поврежденные данные
+inline bool result_decompress(const uint8_t *data, uint64_t size, uint64_t count, uint64_t elem, uint64_t i, void *dst)
+{
+    uint64_t blocks = result_blocks(count),
+             n,
+             first,
+             last;
+    vector<uint8_t> buffer;
+
+    if (i >= blocks or size < (blocks + 1) * sizeof(uint64_t))
+        return false;
+    n = min(result_block_values, count - i * result_block_values);
+    buffer.resize(n * elem);
+    memcpy(&first, data + i * sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&last, data + (i + 1) * sizeof(uint64_t), sizeof(uint64_t));
+    if (first > last or last > size or not TBlockCodec::decompress(data + first, last - first, buffer.data(), buffer.size()))
+        return false;
+    TBlockCodec::unshuffle(buffer.data(), static_cast<uint8_t*>(dst), n, elem);
+    return true;
+}
+
+// Ссылка на файл сетки: хеш его содержимого и путь (length байт следом за структурой),
+// относительный путь отсчитывается от каталога файла результатов
+struct TResultMeshRef
+{
+    uint64_t hash;
+    uint64_t length;
+};
+
+inline uint64_t result_align(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+//-----------------------------------------------------------------------
+// Последовательная запись двоичного файла результатов
+//-----------------------------------------------------------------------
+class TResultFile
+{
+private:
+    ofstream out;
+    TResultHeader header;
+    vector<TResultField> directory;
+    FieldType type = FieldType::Float64;
+    FieldCodec codec = FieldCodec::None;
+    // Запись блока данных с выравниванием начала на 8 байт
+    uint64_t write_block(const void *data, uint64_t size)
+    {
+        char pad[8] = { 0 };
+        uint64_t pos = uint64_t(out.tellp()),
+                 offset = result_align(pos);
+
+        out.write(pad, streamsize(offset - pos));
+        out.write(static_cast<const char*>(data), streamsize(size));
+        return offset;
+    }
+    // Таблица сетки, преобразованная к типу U (с выравниванием начала на 8 байт)
+    template <typename U, typename M> uint64_t write_table(const M &m)
+    {
+        uint64_t offset = write_block(nullptr, 0);
+
+        m.template for_rows<U>(0, m.size1(), [this, &m](const U *p, size_t n) { out.write(reinterpret_cast<const char*>(p), streamsize(n * m.size2() * sizeof(U))); });
+        return offset;
+    }
+    // Размеры и тип сетки в заголовке
+    void set_mesh(const string &fe_type, TCoordTable &x, TIndexTable &fe, TIndexTable &be)
+    {
+        strncpy(header.fe_type, fe_type.c_str(), sizeof(header.fe_type) - 1);
+        header.dim = uint32_t(x.size2());
+        header.fe_size = uint32_t(fe.size2());
+        header.be_size = uint32_t(be.size2());
+        header.nodes = int64_t(x.size1());
+        header.fe_count = int64_t(fe.size1());
+        header.be_count = int64_t(be.size1());
+    }
+public:
+    TResultFile(void) noexcept {}
+    ~TResultFile(void) = default;
+    // Открытие файла (is_float - хранение значений в float32, is_compressed - сжатие полей);
+    // ошибки - исключение fstream::failure
+    void open(const string &name, bool is_float = false, bool is_compressed = false)
+    {
+        out.exceptions(ofstream::failbit | ofstream::badbit);
+        out.open(name, ios::binary);
+        memset(&header, 0, sizeof(header));
+        memcpy(header.signature, result_signature, sizeof(header.signature));
+        header.version = result_version;
+        directory.clear();
+        type = is_float ? FieldType::Float32 : FieldType::Float64;
+        codec = is_compressed ? FieldCodec::Block : FieldCodec::None;
+        // Место под заголовок; окончательно он записывается при закрытии
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    void write_mesh(const string &fe_type, TCoordTable &x, TIndexTable &fe, TIndexTable &be)
+    {
+        set_mesh(fe_type, x, fe, be);
+        if (sizeof(TIndex) == sizeof(int64_t))
+            header.flags |= result_index64;
+        header.x_offset = write_table<double>(x);
+        header.fe_offset = write_table<TIndex>(fe);
+        header.be_offset = write_table<TIndex>(be);
+    }
+    // Вместо сетки записываются путь к ее файлу и хеш его содержимого (размеры сохраняются для контроля;
+    // fe_count - количество КЭ, если fe содержит только блок таблицы)
+    void write_mesh_ref(const string &fe_type, const string &path, uint64_t hash, TCoordTable &x, TIndexTable &fe, TIndexTable &be, size_t fe_count)
+    {
+        TResultMeshRef ref{ hash, path.length() };
+
+        set_mesh(fe_type, x, fe, be);
+        header.fe_count = int64_t(fe_count);
+        header.flags |= result_mesh_ref;
+        header.x_offset = write_block(&ref, sizeof(ref));
+        out.write(path.data(), streamsize(path.length()));
+    }
+    void write_result(const string &name, double time, const vector<double> &res)
+    {
+        TResultField field;
+        vector<float> buffer;
+        vector<uint8_t> packed;
+
+        memset(&field, 0, sizeof(field));
+        strncpy(field.name, name.c_str(), sizeof(field.name) - 1);
+        field.time = time;
+        field.count = res.size();
+        field.type = type;
+        field.codec = codec;
+        if (type == FieldType::Float32)
+            buffer.assign(res.begin(), res.end());
+        if (codec == FieldCodec::Block)
+        {
+            if (type == FieldType::Float32)
+                result_compress(buffer.data(), buffer.size(), sizeof(float), packed);
+            else
+                result_compress(res.data(), res.size(), sizeof(double), packed);
+            field.size = packed.size();
+            field.offset = write_block(packed.data(), field.size);
+        }
+        else if (type == FieldType::Float32)
+        {
+            field.size = buffer.size() * sizeof(float);
+            field.offset = write_block(buffer.data(), field.size);
+        }
+        else
+        {
+            field.size = res.size() * sizeof(double);
+            field.offset = write_block(res.data(), field.size);
+        }
+        directory.push_back(field);
+    }
+    void close(int64_t solution_time)
+    {
+        header.solution_time = solution_time;
+        header.field_count = uint32_t(directory.size());
+        header.directory_offset = write_block(directory.data(), directory.size() * sizeof(TResultField));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+    }
+};
+
+#endif // RESFILE_H
@@ -0,0 +1,274 @@
+#ifndef VTUFILE_H
+#define VTUFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include <filesystem>
+#include <numeric>
+#include <atomic>
+#include "analyse/analyse.h"
+#include "mesh/mesh.h"
+#include "thread/workers.h"
+
+using namespace std;
+
+/***************************************************/
+/*   Файл VTK XML (UnstructuredGrid, .vtu/.pvtu)   */
+/*  с двоичными данными в разделе AppendedData     */
+/***************************************************/
+class TVtuFile
+{
+private:
+    // Часть сетки: узлы (номера в исходной сетке), связность в локальной нумерации и значения полей
+    struct TPiece
+    {
+        vector<double> points;
+        vector<TIndex> connectivity;
+        vector<TIndex> offsets;
+        vector<uint8_t> types;
+        vector<vector<double>> fields;
+    };
+    // Тип индексов VTK по разрядности TIndex
+    static const char *index_type(void) noexcept
+    {
+        return sizeof(TIndex) == sizeof(int64_t) ? "Int64" : "Int32";
+    }
+    // Тип ячейки VTK для типа КЭ (узлы квадратичных элементов: сначала вершины, затем середины ребер)
+    static uint8_t cell_type(FEType type)
+    {
+        switch (type)
+        {
+        case FEType::fe1d2:
+            return 3;   // VTK_LINE
+        case FEType::fe2d3:
+        case FEType::fe2d3p:
+        case FEType::fe3d3s:
+            return 5;   // VTK_TRIANGLE
+        case FEType::fe2d4:
+        case FEType::fe2d4p:
+        case FEType::fe3d4s:
+            return 9;   // VTK_QUAD
+        case FEType::fe2d6:
+        case FEType::fe2d6p:
+        case FEType::fe3d6s:
+            return 22;  // VTK_QUADRATIC_TRIANGLE
+        case FEType::fe3d4:
+            return 10;  // VTK_TETRA
+        case FEType::fe3d8:
+            return 12;  // VTK_HEXAHEDRON
+        case FEType::fe3d10:
+            return 24;  // VTK_QUADRATIC_TETRA
+        default:
+            throw TError(Message::IncorrectFE);
+        }
+    }
+    // Выделение из сетки элементов с номерами [first, last) и узлов, на которые они опираются
+    // (в потоковом режиме сетки элементы читаются блоками); local - карта номеров узлов размером
+    // с сетку, заполненная -1 (используется повторно: после выделения части снова заполнена -1)
+    static void make_piece(TPiece &piece, TMesh &mesh, TResultList &results, size_t first, size_t last, vector<TIndex> &local)
+    {
+        TCoordTable &x = mesh.get_x();
+        size_t size = mesh.get_fe().size2();
+        vector<TIndex> nodes;
+        uint8_t type = cell_type(mesh.get_type());
+
+        // Вся сетка записывается в исходной нумерации узлов
+        if (first == 0 and last == mesh.get_fe_count())
+        {
+            iota(local.begin(), local.end(), 0);
+            nodes = local;
+        }
+        piece.connectivity.reserve((last - first) * size);
+        for (size_t start = first, count; start < last; start += count)
+        {
+            count = min(mesh.load_fe(start), last - start);
+            for (auto i = start; i < start + count; i++)
+            {
+                for (auto j = 0u; j < size; j++)
+                {
+                    TIndex &k = local[size_t(mesh.get_fe(i, j))];
+
+                    if (k < 0)
+                    {
+                        k = TIndex(nodes.size());
+                        nodes.push_back(mesh.get_fe(i, j));
+                    }
+                    piece.connectivity.push_back(k);
+                }
+                piece.offsets.push_back(TIndex(piece.connectivity.size()));
+                piece.types.push_back(type);
+            }
+        }
+        // Координаты в VTK всегда трехмерные
+        piece.points.assign(nodes.size() * 3, 0.0);
+        for (auto i = 0u; i < nodes.size(); i++)
+        {
+            x.get_row(size_t(nodes[i]), piece.points.data() + i * 3);
+            local[size_t(nodes[i])] = -1;
+        }
+        piece.fields.resize(results.size());
+        for (auto k = 0u; k < results.size(); k++)
+        {
+            vector<double> &res = results[k].get_results();
+
+            if (res.size() not_eq x.size1())
+                throw TError(Message::InternalError);
+            piece.fields[k].resize(nodes.size());
+            for (auto i = 0u; i < nodes.size(); i++)
+                piece.fields[k][i] = res[size_t(nodes[i])];
+        }
+    }
+    // Запись части сетки в файл .vtu; ошибки - исключение fstream::failure
+    static void write_piece(const string &name, const TPiece &piece, TResultList &results)
+    {
+        ofstream out;
+        uint64_t offset = 0;
+        auto array = [&out, &offset](const string &type, const string &name, unsigned components, size_t size)
+        {
+            out << "        <DataArray type=\"" << type << "\" Name=\"" << name << "\" NumberOfComponents=\"" << components <<
+                   "\" format=\"appended\" offset=\"" << offset << "\"/>" << '\n';
+            offset += sizeof(uint64_t) + size;
+        };
+        auto data = [&out](const void *ptr, uint64_t size)
+        {
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(static_cast<const char*>(ptr), streamsize(size));
+        };
+
+        out.exceptions(ofstream::failbit | ofstream::badbit);
+        out.open(name, ios::binary);
+        out << "<?xml version=\"1.0\"?>" << '\n';
+        out << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << (is_little_endian() ? "LittleEndian" : "BigEndian") <<
+               "\" header_type=\"UInt64\">" << '\n';
+        out << "  <UnstructuredGrid>" << '\n';
+        out << "    <Piece NumberOfPoints=\"" << piece.points.size() / 3 << "\" NumberOfCells=\"" << piece.types.size() << "\">" << '\n';
+        out << "      <PointData>" << '\n';
+        for (auto k = 0u; k < piece.fields.size(); k++)
+            array("Float64", results[k].get_name(), 1, piece.fields[k].size() * sizeof(double));
+        out << "      </PointData>" << '\n';
+        out << "      <Points>" << '\n';
+        array("Float64", "Points", 3, piece.points.size() * sizeof(double));
+        out << "      </Points>" << '\n';
+        out << "      <Cells>" << '\n';
+        array(index_type(), "connectivity", 1, piece.connectivity.size() * sizeof(TIndex));
+        array(index_type(), "offsets", 1, piece.offsets.size() * sizeof(TIndex));
+        array("UInt8", "types", 1, piece.types.size() * sizeof(uint8_t));
+        out << "      </Cells>" << '\n';
+        out << "    </Piece>" << '\n';
+        out << "  </UnstructuredGrid>" << '\n';
+        // Двоичные массивы в порядке их объявления: размер (UInt64) и данные
+        out << "  <AppendedData encoding=\"raw\">" << '\n' << "_";
+        for (auto &it: piece.fields)
+            data(it.data(), it.size() * sizeof(double));
+        data(piece.points.data(), piece.points.size() * sizeof(double));
+        data(piece.connectivity.data(), piece.connectivity.size() * sizeof(TIndex));
+        data(piece.offsets.data(), piece.offsets.size() * sizeof(TIndex));
+        data(piece.types.data(), piece.types.size() * sizeof(uint8_t));
+        out << '\n' << "  </AppendedData>" << '\n';
+        out << "</VTKFile>" << '\n';
+        out.close();
+    }
+    // Описание параллельного набора файлов (.pvtu)
+    static void write_header(const string &name, const vector<string> &pieces, TResultList &results)
+    {
+        ofstream out;
+
+        out.exceptions(ofstream::failbit | ofstream::badbit);
+        out.open(name);
+        out << "<?xml version=\"1.0\"?>" << '\n';
+        out << "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\"" << (is_little_endian() ? "LittleEndian" : "BigEndian") <<
+               "\" header_type=\"UInt64\">" << '\n';
+        out << "  <PUnstructuredGrid GhostLevel=\"0\">" << '\n';
+        out << "    <PPointData>" << '\n';
+        for (auto k = 0u; k < results.size(); k++)
+            out << "      <PDataArray type=\"Float64\" Name=\"" << results[k].get_name() << "\" NumberOfComponents=\"1\"/>" << '\n';
+        out << "    </PPointData>" << '\n';
+        out << "    <PPoints>" << '\n';
+        out << "      <PDataArray type=\"Float64\" Name=\"Points\" NumberOfComponents=\"3\"/>" << '\n';
+        out << "    </PPoints>" << '\n';
+        for (auto &it: pieces)
+            out << "    <Piece Source=\"" << it << "\"/>" << '\n';
+        out << "  </PUnstructuredGrid>" << '\n';
+        out << "</VTKFile>" << '\n';
+        out.close();
+    }
+    static bool is_little_endian(void)
+    {
+        uint16_t val = 1;
+
+        return *reinterpret_cast<uint8_t*>(&val) == 1;
+    }
+public:
+    // Запись сетки и результатов в name (.vtu); при pieces > 1 элементы делятся на диапазоны, которые
+    // записываются в name_<i>.vtu пулом из TWorkers::count() потоков, а name (.pvtu) ссылается на них
+    // (в потоковом режиме сетки - последовательно, т.к. блок таблицы КЭ в памяти один)
+    static void write(const string &name, TMesh &mesh, TResultList &results, unsigned pieces = 1)
+    {
+        size_t count = mesh.get_fe_count();
+        string base = filesystem::path(name).stem().string();
+        vector<string> files;
+        vector<thread> pool;
+        vector<exception_ptr> error;
+        atomic<unsigned> next{0};
+        size_t workers;
+
+        // Поля загружаются до запуска потоков (обращение к TResultList может считывать их из файла)
+        for (auto k = 0u; k < results.size(); k++)
+            results[k];
+        if (pieces <= 1)
+        {
+            TPiece piece;
+            vector<TIndex> local(mesh.get_x().size1(), -1);
+
+            make_piece(piece, mesh, results, 0, count, local);
+            write_piece(name, piece, results);
+            return;
+        }
+        pieces = unsigned(min(size_t(pieces), max(size_t(1), count)));
+        error.resize(pieces);
+        for (auto i = 0u; i < pieces; i++)
+        {
+            stringstream ss;
+
+            ss << base << "_" << i << ".vtu";
+            files.push_back(ss.str());
+        }
+        // Каждый поток выбирает очередную часть и использует одну карту номеров узлов для всех своих частей
+        auto task = [&]
+        {
+            vector<TIndex> local(mesh.get_x().size1(), -1);
+
+            for (unsigned i; (i = next++) < pieces;)
+                try
+                {
+                    TPiece piece;
+
+                    make_piece(piece, mesh, results, count * i / pieces, count * (i + 1) / pieces, local);
+                    write_piece((filesystem::path(name).parent_path() / files[i]).string(), piece, results);
+                }
+                catch (...)
+                {
+                    error[i] = current_exception();
+                    fill(local.begin(), local.end(), -1);
+                }
+        };
+
+        workers = mesh.is_stream() ? 1 : min(size_t(TWorkers::count()), size_t(pieces));
+        for (size_t k = 1; k < workers; k++)
+            pool.push_back(thread(task));
+        task();
+        for (auto &it: pool)
+            it.join();
+        for (auto &it: error)
+            if (it)
+                rethrow_exception(it);
+        write_header(name, files, results);
+    }
+};
+
+#endif // VTUFILE_H
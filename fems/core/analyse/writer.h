@@ -0,0 +1,157 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include "analyse/analyse.h"
+#include "analyse/resfile.h"
+#include "mesh/mesh.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Фоновая запись результатов: поля передаются по мере их вычисления и
+// записываются отдельным потоком; объем очереди ограничен
+//-----------------------------------------------------------------------
+class TResultWriter
+{
+private:
+    thread worker;
+    mutex mtx;
+    condition_variable cv;
+    deque<TResult> queue;
+    // Максимальный объем данных в очереди (байт)
+    size_t capacity;
+    size_t queued = 0;
+    bool is_finished = false;
+    exception_ptr error;
+    // Текстовый (.res) и двоичный (.bres) выходные файлы
+    ofstream text;
+    TResultFile binary;
+    bool is_text = false;
+    bool is_binary = false;
+    // Операции, выполняемые потоком перед записью полей (запись сетки и заголовков)
+    list<function<void(void)>> prologue;
+    void run(void)
+    {
+        TResult r;
+
+        try
+        {
+            for (auto &it: prologue)
+                it();
+            while (true)
+            {
+                {
+                    unique_lock<mutex> lock(mtx);
+
+                    cv.wait(lock, [this] { return queue.size() or is_finished; });
+                    if (queue.empty())
+                        break;
+                    r = move(queue.front());
+                    queue.pop_front();
+                    queued -= r.get_results().size() * sizeof(double);
+                }
+                cv.notify_all();
+                if (is_text)
+                    r.write(text);
+                if (is_binary)
+                    binary.write_result(r.get_name(), r.get_time(), r.get_results());
+            }
+            if (is_text)
+                text.close();
+            if (is_binary)
+                binary.close(int64_t(chrono::system_clock::to_time_t(chrono::system_clock::now())));
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(mtx);
+
+            error = current_exception();
+            queue.clear();
+            queued = 0;
+            cv.notify_all();
+        }
+    }
+public:
+    TResultWriter(size_t c = size_t(256) << 20) noexcept : capacity{c} {}
+    ~TResultWriter(void)
+    {
+        if (worker.joinable())
+        {
+            {
+                lock_guard<mutex> lock(mtx);
+
+                is_finished = true;
+            }
+            cv.notify_all();
+            worker.join();
+        }
+    }
+    // Текстовый файл: подпись, сетка (или ссылка на ее файл при is_ref) и заголовок списка из count результатов
+    void open_text(const string &name, TMesh &mesh, unsigned count, bool is_ref = false)
+    {
+        text.exceptions(ofstream::failbit | ofstream::badbit);
+        text.open(name);
+        text.precision(16);
+        is_text = true;
+        prologue.push_back([this, &mesh, count, is_ref, dir = filesystem::path(name).parent_path().string()]
+        {
+            text << "FEM Solver Results File" << '\n';
+            if (is_ref)
+                mesh.write_ref(text, dir);
+            else
+                mesh.write(text);
+            text << "Results" << '\n';
+            text << chrono::system_clock::to_time_t(chrono::system_clock::now()) << '\n';
+            text << count << '\n';
+        });
+    }
+    void open_binary(const string &name, TMesh &mesh, bool is_float, bool is_ref = false, bool is_compressed = false)
+    {
+        binary.open(name, is_float, is_compressed);
+        is_binary = true;
+        if (is_ref)
+            prologue.push_back([this, &mesh, dir = filesystem::path(name).parent_path().string()] { mesh.write_ref(binary, dir); });
+        else
+            prologue.push_back([this, &mesh] { mesh.write(binary); });
+    }
+    void start(void)
+    {
+        worker = thread(&TResultWriter::run, this);
+    }
+    // Передача поля на запись (ожидание, если очередь заполнена)
+    void push(const TResult &r)
+    {
+        size_t size = r.get_size() * sizeof(double);
+        unique_lock<mutex> lock(mtx);
+
+        cv.wait(lock, [this, size] { return error or queue.empty() or queued + size <= capacity; });
+        if (error)
+            return;
+        queue.push_back(r);
+        queued += size;
+        cv.notify_all();
+    }
+    // Завершение записи; ошибка потока записи передается вызывающему
+    void finish(void)
+    {
+        {
+            lock_guard<mutex> lock(mtx);
+
+            is_finished = true;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+        if (error)
+            rethrow_exception(error);
+    }
+};
+
+#endif // WRITER_H
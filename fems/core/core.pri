@@ -0,0 +1,69 @@
+# Ядро FEM Solver: подключается приложением (fems.pro) и библиотекой (lib/lib.pro)
+CONFIG += c++17
+CONFIG -= qt
+
+msvc:QMAKE_CXXFLAGS += /permissive-
+
+INCLUDEPATH += $$PWD/../../../../eigen \
+               $$PWD
+
+unix:LIBS +=-lpthread
+
+# Пакетная обработка КЭ: ширина пакета выбирается по доступному набору SIMD-инструкций (qmake CONFIG+=simd_native)
+simd_native {
+    unix:QMAKE_CXXFLAGS += -march=native
+    msvc:QMAKE_CXXFLAGS += /arch:AVX2
+}
+
+# 64-битные номера узлов и ненулевых элементов матрицы для сверхбольших моделей (qmake CONFIG+=index64),
+# Pardiso вызывается через 64-битный интерфейс (pardiso_64)
+index64:DEFINES += FEMS_INDEX64
+
+win32 {
+    INCLUDEPATH += $$PWD/../../../../intel/compilers_and_libraries_2019.5.281/windows/mkl/include/
+    LIBS += -L$$PWD/../../../../intel/compilers_and_libraries_2019.5.281/windows/mkl/lib/intel64_win/ -lmkl_core -lmkl_intel_lp64 -lmkl_sequential
+}
+
+unix {
+    INCLUDEPATH += $$PWD/../../../../intel/mkl/include/
+    LIBS += -L$$PWD/../../../../intel/mkl/lib/intel64/ -lmkl_intel_lp64 -lmkl_sequential -lmkl_core
+}
+
+SOURCES += \
+    $$PWD/mesh/mesh.cpp \
+    $$PWD/solver/eigensolver.cpp
+
+HEADERS += \
+    $$PWD/fems.h \
+    $$PWD/analyse/analyse.h \
+    $$PWD/analyse/resfile.h \
+    $$PWD/analyse/writer.h \
+    $$PWD/analyse/vtufile.h \
+    $$PWD/fem/fem.h \
+    $$PWD/fem/sweep.h \
+    $$PWD/file/mapfile.h \
+    $$PWD/file/textfile.h \
+    $$PWD/file/codec.h \
+    $$PWD/hash/hash.h \
+    $$PWD/mesh/mesh.h \
+    $$PWD/mesh/meshfile.h \
+    $$PWD/mesh/generator.h \
+    $$PWD/msg/msg.h \
+    $$PWD/parser/defs.h \
+    $$PWD/parser/node.h \
+    $$PWD/parser/parser.h \
+    $$PWD/shape/shape.h \
+    $$PWD/shape/batch.h \
+    $$PWD/matrix/index.h \
+    $$PWD/matrix/matrix.h \
+    $$PWD/matrix/packed.h \
+    $$PWD/matrix/view.h \
+    $$PWD/solver/blockmatrix.h \
+    $$PWD/solver/eigensolver.h \
+    $$PWD/solver/snapshot.h \
+    $$PWD/solver/solver.h \
+    $$PWD/service/service.h \
+    $$PWD/trace/trace.h \
+    $$PWD/trace/counters.h \
+    $$PWD/thread/workers.h \
+    $$PWD/value/value.h
@@ -6,11 +6,19 @@
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <typeinfo>
+#include <sstream>
+#include "hash/hash.h"
+#include "matrix/view.h"
 #include "mesh/mesh.h"
 #include "shape/shape.h"
+#include "shape/batch.h"
 #include "parser/parser.h"
 #include "shape/shape.h"
 #include "analyse/analyse.h"
+#include "analyse/writer.h"
+#include "analyse/vtufile.h"
+#include "trace/trace.h"
 
 using namespace std;
 
@@ -19,9 +27,13 @@ using namespace std;
 //---------------------------------------------------------
 template <class S> class TFEM
 {
+    // Доступ к отдельным этапам расчета для микробенчмарков (bench/bench.cpp)
+    friend class TBench;
 private:
     // Имя файла с программой расчета
     string prog_name;
+    // Имя файлов результатов без расширения (пустое - имя программы)
+    string result_name;
     // Решатель СЛАУ
     S solver;
     // Сетка
@@ -30,47 +42,221 @@ private:
     list<string> program;
     // Результаты расчета
     TResultList results;
+    // Каталог кэша собранных систем уравнений (директива #cache)
+    string cache_dir;
+    // Форматы вывода результатов и их параметры (директива #output)
+    list<pair<string, string>> output;
+    // Ключ системы уравнений, матрица которой находится в решателе
+    uint64_t system_key = 0;
+    // Ключ сетки, для которой в решателе сформирована структура матрицы
+    uint64_t pattern_key = 0;
+    // Значения констант и нагрузок текущего варианта расчета (см. TSweep)
+    list<pair<string, double>> parameters;
+    // Диапазоны параметров (директивы #sweep)
+    list<pair<string, vector<double>>> sweep;
+    // Способ хранения матрицы системы (директива #matrix)
+    string matrix_options;
+    // Бюджет оперативной памяти разложения (Мб) и каталог файлов внешней памяти (директива #memory)
+    size_t memory_budget = 0;
+    string memory_dir;
+    // Файлы трассировки этапов расчета (директива #trace)
+    bool is_trace = false;
+    string trace_options;
     // Запуск вычислительного процесса
     template <typename T> void run(void)
     {
         TParser<T> parser;
         vector<double> res;
+        uint64_t key;
+        bool is_matrix;
 
+        // Поля предыдущего расчета (в т.ч. другой программы) не должны остаться в результатах
+        results.clear();
+        parser.set_parameters(parameters);
         parser.set_program(program);
-        solver.setup(mesh);
-        create_global_matrix(parser);
-        use_boundary_condition(parser);
+        key = get_system_key(parser);
+        {
+            TTraceScope trace("setup", mesh.get_x().size1() * size_t(mesh.get_freedom()));
+
+            if (key == system_key and solver.isFactorized())
+            {
+                // Матрица системы уже разложена - формируется только правая часть
+                solver.clearLoad();
+                is_matrix = false;
+            }
+            else
+            {
+                solver.setOutOfCore(memory_budget, memory_dir);
+                // Структура матрицы для той же сетки сохраняется, обнуляются только значения
+                if (get_pattern_key() == pattern_key)
+                    solver.clearMatrix();
+                else
+                {
+                    solver.setSymmetric(not has_option(matrix_options, "full"));
+                    solver.setBlock(has_option(matrix_options, "block"));
+                    solver.setMixed(has_option(matrix_options, "mixed"));
+                    solver.setup(mesh);
+                }
+                pattern_key = get_pattern_key();
+                is_matrix = not (cache_dir.length() and read_cache(key));
+            }
+        }
+        create_global_matrix(parser, is_matrix);
+        use_boundary_condition(parser, is_matrix);
+        if (is_matrix and cache_dir.length())
+            write_cache(key);
+        system_key = key;
         if (solve_equations(res))
         {
-            calc_results(parser, res);
-            save_result(prog_name.substr(0, prog_name.find_last_of(".")) + ".res");
+            TResultWriter writer;
+
+            if (prog_name.empty())
+                // Программа задана строкой - результаты остаются в памяти
+                calc_results(parser, res);
+            else
+            {
+                // Запись результатов выполняется параллельно с их вычислением
+                open_writer(writer, parser.get_result_table().size() + parser.get_function_table().size());
+                calc_results(parser, res, &writer);
+                {
+                    TTraceScope trace("write", results.size());
+
+                    close_writer(writer);
+                    save_vtu();
+                }
+            }
             print_result_summary();
+            if (is_trace and prog_name.length())
+                save_trace();
         }
     }
     // Формирование глобальной матрицы жесткости
-    template <typename T> void create_global_matrix(TParser<T> &parser)
+    template <typename T> void create_global_matrix(TParser<T> &parser, bool is_matrix = true)
     {
         TProgress progress;
+        TShapeBatch<T> batch;
+        TTraceScope trace("assembly", mesh.get_fe_count());
 
-        progress.set_process(Message::GeneratingMatrix, 1, (int)mesh.get_fe().size1());
-        for (auto i = 0u; i < mesh.get_fe().size1(); i++)
+        progress.set_process(Message::GeneratingMatrix, 1, mesh.get_fe_count());
+        // КЭ обрабатываются пакетами: геометрия пакета вычисляется совместно, затем локальные матрицы разносятся по КЭ
+        // (в потоковом режиме сетки - по блокам таблицы КЭ, см. TMesh::load_fe)
+        for (size_t first = 0, count; first < mesh.get_fe_count(); first += count)
         {
-            progress.add_progress();
-            parser.set_data(mesh.get_shape<T>(i));
-            ansamble_local_matrix(parser.run(mesh.get_coord_fe(i)).asMatrix(), i);
+            count = mesh.load_fe(first);
+            for (auto i = first; i < first + count; i += batch.width())
+            {
+                batch.pack(mesh, i);
+                batch.evaluate();
+                for (auto l = 0; l < batch.size(); l++)
+                {
+                    progress.add_progress();
+                    parser.set_data(batch.shape(l));
+                    ansamble_local_matrix(parser.run(batch.coord(l), batch.get_jacobian(l)).asMatrix(), batch.index(l), is_matrix);
+                }
+            }
         }
         progress.stop_process();
     }
     // Учет граничных условий
-    template <typename T> void use_boundary_condition(TParser<T> &parser)
+    template <typename T> void use_boundary_condition(TParser<T> &parser, bool is_matrix = true)
     {
         TProgress progress;
-        list<tuple<int, int, int, double>> bc;
+        list<tuple<TIndex, int, int, double>> bc;
+        TTraceScope trace("boundary_conditions");
 
         progress.set_process(Message::UsingBoundaryCondition);
         parser.get_boundary_conditions(mesh, bc);
+        trace.set_count(bc.size());
         for (auto [i, type, dir, val]: bc)
-            (type == 1) ? solver.setBoundaryCondition(i * mesh.get_freedom() + dir, val) : solver.setLoad(i * mesh.get_freedom() + dir, val);
+            if (type not_eq 1)
+                solver.setLoad(i * mesh.get_freedom() + dir, val);
+            else if (is_matrix)
+                solver.setBoundaryCondition(i * mesh.get_freedom() + dir, val);
+            else
+                solver.setBoundaryLoad(i * mesh.get_freedom() + dir, val);
+        progress.stop();
+    }
+    // Связность сетки в ключах (в потоковом режиме таблица КЭ не хранится - используется хеш файла сетки)
+    THash &add_topology(THash &hash)
+    {
+        return mesh.is_stream() ? hash.add(mesh.get_hash()) : hash.add(mesh.get_fe());
+    }
+    template <typename T> list<string> parameter_names(void) const
+    {
+        TParser<T> parser;
+        list<string> names;
+
+        parser.set_program(program);
+        for (auto &it: parser.get_constant_table())
+            names.push_back(it.first);
+        for (auto &it: parser.get_load_table())
+            names.push_back(it.first);
+        return names;
+    }
+    // Ключ системы уравнений: сетка, программа без описания нагрузок и тип решателя
+    template <typename T> uint64_t get_system_key(TParser<T> &parser)
+    {
+        THash hash;
+
+        add_topology(hash.add(int(mesh.get_type())).add(mesh.get_x())).add(mesh.get_be());
+        for (auto &str: program)
+            if (not is_load_statement(parser, str))
+                hash.add(str);
+        for (auto &[name, value]: parameters)
+            if (not is_load_statement(parser, name))
+                hash.add(name).add(value);
+        hash.add(string(typeid(S).name()));
+        return hash.value();
+    }
+    // Ключ структуры матрицы: тип КЭ, число узлов, связность, способ хранения и разложения
+    uint64_t get_pattern_key(void)
+    {
+        THash hash;
+
+        return add_topology(hash.add(int(mesh.get_type())).add(mesh.get_x().size1())).add(int(has_option(matrix_options, "full"))).add(int(has_option(matrix_options, "block")))
+                   .add(int(has_option(matrix_options, "mixed"))).value();
+    }
+    // Проверка, относится ли строка программы только к нагрузкам (объявление или задание нагрузки)
+    template <typename T> bool is_load_statement(TParser<T> &parser, string str)
+    {
+        auto pos = str.find_first_not_of(" \t");
+        auto len = (pos == string::npos) ? 0 : str.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_", pos) - pos;
+        auto &load = parser.get_load_table();
+
+        if (not len)
+            return false;
+        str = str.substr(pos, len);
+        if (str.length() == 4 and toupper(str[0]) == 'L' and toupper(str[1]) == 'O' and toupper(str[2]) == 'A' and toupper(str[3]) == 'D')
+            return true;
+        return find_if(load.begin(), load.end(), [str](auto &i) { return i.first == str; }) not_eq load.end();
+    }
+    string cache_file(uint64_t key)
+    {
+        return (filesystem::path(cache_dir) / (THash().add(key).str() + ".mtx")).string();
+    }
+    bool read_cache(uint64_t key)
+    {
+        TProgress progress;
+        bool ret;
+
+        if (not filesystem::exists(cache_file(key)))
+            return false;
+        progress.set_process(Message::ReadingCache);
+        ret = solver.loadMatrix(cache_file(key));
+        progress.stop();
+        // Поврежденный файл кэша игнорируется - система будет собрана заново
+        if (not ret)
+            solver.setup(mesh);
+        return ret;
+    }
+    void write_cache(uint64_t key)
+    {
+        TProgress progress;
+        error_code ec;
+
+        progress.set_process(Message::WritingCache);
+        filesystem::create_directories(cache_dir, ec);
+        solver.saveMatrix(cache_file(key));
         progress.stop();
     }
     // Решение СЛАУ
@@ -89,116 +275,458 @@ private:
 //            cout << res;
         return (is_aborted) ? false : ret;
     }
-    // Вычисление деформаций и напряжений
-    template <typename T> void calc_results(TParser<T> &parser, vector<double> &u)
+    // Вычисление деформаций и напряжений (перемещения передаются на запись в writer до прохода по КЭ,
+    // функции - после осреднения)
+    template <typename T> void calc_results(TParser<T> &parser, vector<double> &u, TResultWriter *writer = nullptr)
     {
         TProgress progress;
+        TShapeBatch<T> batch;
+        TTraceScope trace("recovery", mesh.get_fe_count() * parser.get_function_table().size());
         matrix<double> res(parser.get_result_table().size() + parser.get_function_table().size(), mesh.get_x().size1());
         vector<double> fe_u,
                        value,
                        counter(mesh.get_x().size1()); // Счетчик кол-ва вхождения узлов для осреднения результатов
+        auto save = [&](unsigned i)
+        {
+            string name = i < parser.get_result_table().size() ? parser.get_result_table()[i].first : parser.get_function_table()[i - mesh.get_freedom()].first;
 
-        // Копируем результаты расчета (перемещения)
+            results.set_result(res[i], (int)res.size2(), name);
+            if (writer)
+                writer->push(results[unsigned(results.index(name))]);
+        };
+
+        // Копируем результаты расчета (перемещения) - их запись идет параллельно с вычислением функций
         for (auto i = 0u; i < mesh.get_x().size1(); i++)
             for (auto j = 0; j < mesh.get_freedom(); j++)
                 res(j, i) = u[i * mesh.get_freedom() + j];
-        // Вычисляем вспомогательные функции (деформации и напряжения)
-        progress.set_process(Message::GeneratingResult, 1, (int)mesh.get_fe().size1());
-        for (auto i = 0u; i < mesh.get_fe().size1(); i++)
+        for (auto j = 0; j < mesh.get_freedom(); j++)
+            save(j);
+        // Вычисляем вспомогательные функции (деформации и напряжения) за один проход по КЭ
+        // (в потоковом режиме таблица КЭ читается блоками)
+        progress.set_process(Message::GeneratingResult, 1, mesh.get_fe_count());
+        for (size_t first = 0, count; first < mesh.get_fe_count(); first += count)
         {
-            progress.add_progress();
-            // Формируем вектор перемещений для текущего КЭ
-            fe_u.resize(mesh.get_fe().size2() * mesh.get_freedom());
-            for (auto j = 0u; j < mesh.get_fe().size2(); j++)
-                for (auto k = 0; k < mesh.get_freedom(); k++)
-                    fe_u[j * mesh.get_freedom() + k] = u[mesh.get_freedom() * mesh.get_fe(i, j) + k];
-            // Загружаем результирующие функции (перемещения)
-            parser.set_data(mesh.get_shape<T>(i), fe_u);
-            for (auto j = 0u; j < parser.get_function_table().size(); j++)
-                for (auto k = 0u; k < mesh.get_fe().size2(); k++)
+            count = mesh.load_fe(first);
+            for (auto b = first; b < first + count; b += batch.width())
+            {
+                batch.pack(mesh, b);
+                batch.evaluate();
+                for (auto l = 0; l < batch.size(); l++)
                 {
-                    TValue<T>::x = mesh.get_coord_fe(i, k);
-                    value = parser.get_function_table()[j].second.value().asVector();
-                    res(mesh.get_freedom() + j, mesh.get_fe(i, k)) += accumulate(value.begin(), value.end(), 0.0);
-                    if (j == 0)
-                        counter[mesh.get_fe(i, k)]++;
+                    auto i = batch.index(l);
+
+                    progress.add_progress();
+                    // Формируем вектор перемещений для текущего КЭ
+                    fe_u.resize(mesh.get_fe().size2() * mesh.get_freedom());
+                    for (auto m = 0u; m < mesh.get_fe().size2(); m++)
+                        for (auto k = 0; k < mesh.get_freedom(); k++)
+                            fe_u[m * mesh.get_freedom() + k] = u[size_t(mesh.get_freedom()) * size_t(mesh.get_fe(i, m)) + size_t(k)];
+                    // Загружаем результирующие функции (перемещения)
+                    parser.set_data(batch.shape(l), fe_u);
+                    for (auto k = 0u; k < mesh.get_fe().size2(); k++)
+                    {
+                        auto x = mesh.get_coord_fe(i, k);
+                        auto node = size_t(mesh.get_fe(i, k));
+
+                        for (auto j = 0u; j < parser.get_function_table().size(); j++)
+                        {
+                            value = parser.get_function(j, x);
+                            res(mesh.get_freedom() + j, node) += accumulate(value.begin(), value.end(), 0.0);
+                        }
+                        counter[node]++;
+                    }
                 }
+            }
         }
         progress.stop_process();
-        // Осредняем результаты
-        for (auto i = mesh.get_freedom(); i < (int)res.size1(); i++)
-            for (auto j = 0u; j< mesh.get_x().size1(); j++)
-                res[i][j] /= counter[j];
-        // Cохраняем результаты
-        for (auto i = 0u; i < res.size1(); i++)
-            results.set_result(res[i], (int)res.size2(), i < parser.get_result_table().size() ? parser.get_result_table()[i].first : parser.get_function_table()[i - mesh.get_freedom()].first);
+        // Осредняем результаты и передаем их на запись
+        for (auto j = 0u; j < parser.get_function_table().size(); j++)
+        {
+            for (auto k = 0u; k < mesh.get_x().size1(); k++)
+                res[mesh.get_freedom() + j][k] /= counter[k];
+            save(mesh.get_freedom() + j);
+        }
+    }
+    // Подготовка фоновой записи результатов в заданных форматах (в потоковом режиме сетка записывается
+    // ссылкой на ее файл: таблица КЭ во время записи читается блоками при вычислении результатов)
+    void open_writer(TResultWriter &writer, unsigned count)
+    {
+        string name = get_result_name();
+
+        try
+        {
+            if (output.empty())
+                writer.open_text(name + ".res", mesh, count, mesh.is_stream());
+            for (auto &[format, options]: output)
+                if (format == "text")
+                    writer.open_text(name + ".res", mesh, count, has_option(options, "meshref") or mesh.is_stream());
+                else if (format == "binary")
+                    writer.open_binary(name + ".bres", mesh, has_option(options, "float32"), has_option(options, "meshref") or mesh.is_stream(), has_option(options, "compress"));
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+        writer.start();
+    }
+    // Запись сетки и результатов в формате VTK (директива "#output vtu [число частей]")
+    void save_vtu(void)
+    {
+        string name = get_result_name();
+        TProgress progress;
+
+        for (auto &[format, options]: output)
+            if (format == "vtu")
+            {
+                unsigned pieces = vtu_pieces(options);
+
+                progress.set_process(Message::WritingResult);
+                try
+                {
+                    TVtuFile::write(name + (pieces > 1 ? ".pvtu" : ".vtu"), mesh, results, pieces);
+                    progress.stop();
+                }
+                catch (fstream::failure&)
+                {
+                    progress.stop();
+                    throw TError(Message::ReadFile);
+                }
+            }
+    }
+    // Ожидание окончания записи результатов
+    void close_writer(TResultWriter &writer)
+    {
+        TProgress progress;
+
+        progress.set_process(Message::WritingResult);
+        try
+        {
+            writer.finish();
+            progress.stop();
+        }
+        catch (fstream::failure&)
+        {
+            progress.stop();
+            throw TError(Message::ReadFile);
+        }
     }
     // Ансамблирование локальной матрицы жесткости к глобальной
-    void ansamble_local_matrix(const matrix<double> &lm, unsigned i)
+    void ansamble_local_matrix(const matrix<double> &lm, size_t i, bool is_matrix = true)
     {
-        unsigned freedom = mesh.get_freedom(),
-                 size = (unsigned)lm.size1();
+        TIndex freedom = mesh.get_freedom();
+        unsigned size = (unsigned)lm.size1();
 
         /////////////////
         // cout << lm << endl;
         /////////////////
-        // Учет матрицы
-        for (unsigned l = 0; l < size; l++)
+        // Учет матрицы (симметричная пара элементов добавляется одним вызовом, см. TEigenSolver::addSymmetric)
+        for (TIndex l = 0; l < TIndex(size); l++)
         {
-            for (unsigned k = l; k < size; k++)
-            {
-                solver.addMatrix(lm(l, k), mesh.get_fe(i, l / freedom) * freedom + l % freedom, mesh.get_fe(i, k / freedom) * freedom + k % freedom);
-                if (l not_eq k)
-                    solver.addMatrix(lm(l, k), mesh.get_fe(i, k / freedom) * freedom + k % freedom, mesh.get_fe(i, l / freedom) * freedom + l % freedom);
-            }
-            solver.addLoad(lm(l, size), mesh.get_fe(i, l / freedom) * freedom + l % freedom);
+            for (TIndex k = l; k < TIndex(size) and is_matrix; k++)
+                solver.addSymmetric(lm(size_t(l), size_t(k)), mesh.get_fe(i, size_t(l / freedom)) * freedom + l % freedom, mesh.get_fe(i, size_t(k / freedom)) * freedom + k % freedom);
+            solver.addLoad(lm(size_t(l), size), mesh.get_fe(i, size_t(l / freedom)) * freedom + l % freedom);
         }
     }
-    string parse_mesh_file_name(string str)
+    // Разбор директивы препроцессора вида "#имя значение"
+    static pair<string, string> parse_directive(string str)
     {
+        string name;
+
         if (str[0] not_eq '#')
             throw TError(Message::Preprocessor);
-        str = str.substr(1, str.length());
-        str = str.substr(str.find_first_not_of(" \t"), str.length());
-        if (str.substr(0, 4) not_eq "mesh" )
+        str = str.substr(1, str.find_last_not_of(" \t\r"));
+        if (str.find_first_not_of(" \t") == string::npos)
             throw TError(Message::Preprocessor);
-        str = str.substr(5, str.length());
-        return str.substr(str.find_first_not_of(" \t"), str.length());
+        str = str.substr(str.find_first_not_of(" \t"), str.length());
+        name = str.substr(0, str.find_first_of(" \t"));
+        str = str.substr(name.length(), str.length());
+        // Значение может отсутствовать (директива "#trace")
+        return { name, str.find_first_not_of(" \t") == string::npos ? "" : str.substr(str.find_first_not_of(" \t")) };
     }
-public:
-    TFEM(void) noexcept {}
-    ~TFEM(void) noexcept = default;
-    void set_program(string name)
+    // Разбор текста программы: директивы препроцессора и операторы
+    void read_program(istream &in)
     {
-        fstream file(prog_name = name);
         string str;
         int pos;
-        bool is_mesh = false;
+        size_t stream = 0;
+        bool is_mesh = false,
+             is_compact = false;
 
-        if (file.is_open())
+        program.clear();
+        output.clear();
+        sweep.clear();
+        cache_dir.clear();
+        matrix_options.clear();
+        memory_budget = 0;
+        memory_dir.clear();
+        is_trace = false;
+        // Трассировка начинается с чтения программы (и сетки, если она еще не загружена)
+        TTrace::clear();
+        TTrace::set_counters(false);
+        while (getline(in, str))
         {
-            while (not file.eof())
+            if (str.find_first_not_of(" \t\r") == string::npos)
+                continue;
+            str = str.substr(str.find_first_not_of(" \t"), str.length());
+            if (str[0] == '/' and str[1] == '/')
+                continue;
+            if ((pos = int(str.find("#"))) not_eq -1)
             {
-                getline(file, str);
-                if (not str.length())
-                    continue;
-                str = str.substr(str.find_first_not_of(" \t"), str.length());
-                if (str[0] == '/' and str[1] == '/')
-                    continue;
-                if ((pos = int(str.find("#"))) not_eq -1)
+                auto [directive, value] = parse_directive(str);
+
+                if ((directive == "mesh" or directive == "cache") and value.empty())
+                    throw TError(Message::Preprocessor);
+                if (directive == "mesh")
                 {
-                    mesh.set_mesh_file(filesystem::path(name).parent_path().string(), parse_mesh_file_name(str));
+                    // Сетка, уже прочитанная из того же файла в том же режиме, повторно не считывается
+                    if (not mesh.is_loaded(filesystem::path(prog_name).parent_path().string(), value) or mesh.get_stream() not_eq TMesh::chunk(stream) or
+                        mesh.get_compact() not_eq is_compact)
+                    {
+                        mesh.set_stream(stream);
+                        mesh.set_compact(is_compact);
+                        mesh.set_mesh_file(filesystem::path(prog_name).parent_path().string(), value);
+                    }
                     is_mesh = true;
                 }
+                else if (directive == "stream")
+                    stream = parse_stream(value);
+                // Директива "#compact" (задается до #mesh): координаты узлов хранятся в float
+                // (номера узлов всегда хранятся в наиболее узком типе, вмещающем их количество);
+                // условия граничных условий на координаты при этом сравниваются в одинарной точности
+                else if (directive == "compact")
+                {
+                    if (value.length())
+                        throw TError(Message::Preprocessor);
+                    is_compact = true;
+                }
+                else if (directive == "cache")
+                    cache_dir = directive_path(value);
+                else if (directive == "output")
+                    set_output(value);
+                else if (directive == "sweep")
+                    sweep.push_back(parse_sweep(value));
+                else if (directive == "trace")
+                    set_trace(value);
+                else if (directive == "matrix")
+                    set_matrix(value);
+                else if (directive == "memory")
+                    set_memory(value);
                 else
-                    program.push_back(str);
+                    throw TError(Message::UnknownDirective);
             }
-            file.close();
-            if (not is_mesh)
-                throw TError(Message::NotMesh);
+            else
+                program.push_back(str);
         }
-        else
+        if (not is_mesh and mesh.get_type() == FEType::undefined)
+            throw TError(Message::NotMesh);
+    }
+    // Директива "#trace [metrics] [chrome] [counters]" (по умолчанию - оба файла; counters - аппаратные
+    // счетчики этапов, начиная с этой директивы, поэтому для учета чтения сетки она задается до #mesh)
+    void set_trace(const string &options)
+    {
+        stringstream ss(options);
+        string str;
+
+        while (ss >> str)
+            if (str not_eq "metrics" and str not_eq "chrome" and str not_eq "counters")
+                throw TError(Message::OutputFormat);
+        is_trace = true;
+        trace_options = options;
+        TTrace::set_counters(has_option(options, "counters"));
+    }
+    // Директива "#matrix [block] [full] [mixed]": block - блочное хранение по узлам (блоки freedom x freedom),
+    // full - обе половины симметричной матрицы (по умолчанию - только верхний треугольник),
+    // mixed - разложение в одинарной точности с итерационным уточнением решения
+    void set_matrix(const string &options)
+    {
+        stringstream ss(options);
+        string str;
+
+        while (ss >> str)
+            if (str not_eq "block" and str not_eq "full" and str not_eq "mixed")
+                throw TError(Message::MatrixFormat);
+        matrix_options = options;
+    }
+    // Директива "#stream [количество КЭ в блоке]" (задается до #mesh): таблица КЭ не хранится целиком,
+    // а читается из файла сетки блоками при построении карты связей, ансамблировании и вычислении результатов
+    static size_t parse_stream(const string &value)
+    {
+        stringstream ss(value);
+        long long chunk = 1 << 20;
+
+        if (value.length() and (not (ss >> chunk) or chunk <= 0))
+            throw TError(Message::StreamFormat);
+        return size_t(chunk);
+    }
+    // Директива "#memory бюджет [каталог]": разложение, не помещающееся в бюджет оперативной памяти (Мб),
+    // хранится во временных файлах каталога (по умолчанию - системного временного каталога)
+    void set_memory(const string &value)
+    {
+        stringstream ss(value);
+        string dir;
+        long long budget;
+
+        if (not (ss >> budget) or budget <= 0)
+            throw TError(Message::MemoryFormat);
+        memory_budget = size_t(budget);
+        memory_dir = (ss >> dir) ? directive_path(dir) : "";
+    }
+    // Запись трассировки: <программа>.trace.json - таблица этапов, <программа>.chrome.json - события Chrome trace
+    void save_trace(void)
+    {
+        string name = get_result_name();
+        bool is_all = not has_option(trace_options, "metrics") and not has_option(trace_options, "chrome");
+
+        if (is_all or has_option(trace_options, "metrics"))
+            TTrace::write_metrics(name + ".trace.json", prog_name);
+        if (is_all or has_option(trace_options, "chrome"))
+            TTrace::write_chrome(name + ".chrome.json");
+    }
+    string get_result_name(void) const
+    {
+        return result_name.length() ? result_name : prog_name.substr(0, prog_name.find_last_of("."));
+    }
+    // Путь, заданный в директиве, отсчитывается от каталога программы
+    string directive_path(string path)
+    {
+        return filesystem::path(path).is_absolute() ? path : (filesystem::path(prog_name).parent_path() / path).string();
+    }
+public:
+    TFEM(void) noexcept {}
+    ~TFEM(void) noexcept = default;
+    // Программа расчета из файла; результаты записываются в файлы с тем же именем
+    void set_program(string name)
+    {
+        fstream file(prog_name = name);
+
+        result_name.clear();
+        if (not file.is_open())
             throw TError(Message::ReadFile);
+        read_program(file);
+        file.close();
+    }
+    // Программа расчета из строки; файлы результатов не создаются, результаты доступны через get_result
+    void set_program_text(const string &text)
+    {
+        stringstream ss(text);
+
+        prog_name.clear();
+        result_name.clear();
+        read_program(ss);
+    }
+    // Модель варианта параметрического расчета (см. TSweep): программа модели m без директив вместе с
+    // заданными в ней параметрами #cache, #matrix и #memory; результаты остаются в памяти
+    void set_variant(const TFEM &m)
+    {
+        stringstream ss;
+        string cache = m.cache_dir,
+               options = m.matrix_options,
+               dir = m.memory_dir;
+        size_t budget = m.memory_budget;
+
+        for (auto &str: m.program)
+            ss << str << '\n';
+        set_program_text(ss.str());
+        cache_dir = cache;
+        matrix_options = options;
+        memory_budget = budget;
+        memory_dir = dir;
+    }
+    // Сетка из массивов в памяти (вместо директивы #mesh), см. TMesh::set_mesh
+    void set_mesh(const string &type, TView<double> x, TView<TIndex> fe, TView<TIndex> be = {})
+    {
+        mesh.set_mesh(type, x, fe, be);
+        system_key = pattern_key = 0;
+    }
+    // Сетка, уже загруженная другой моделью (копия вместе с картой связей)
+    void set_mesh(const TMesh &m)
+    {
+        mesh = m;
+        system_key = pattern_key = 0;
+    }
+    // Значения констант и нагрузок, заменяющие заданные в программе (применяются при следующем start)
+    void set_parameters(const list<pair<string, double>> &p)
+    {
+        parameters = p;
+    }
+    auto &get_sweep(void) const noexcept
+    {
+        return sweep;
+    }
+    auto &get_program(void) const noexcept
+    {
+        return program;
+    }
+    auto &get_output(void) const noexcept
+    {
+        return output;
+    }
+    // Файл сетки, заданный директивой #mesh программы name (пустая строка, если не задан)
+    static string get_mesh_file(const string &name)
+    {
+        ifstream file(name);
+        string str;
+
+        while (getline(file, str))
+        {
+            if (str.find_first_not_of(" \t\r") == string::npos or str[str.find_first_not_of(" \t")] not_eq '#')
+                continue;
+            if (auto [directive, value] = parse_directive(str.substr(str.find_first_not_of(" \t"))); directive == "mesh")
+                return filesystem::exists(value) ? value : filesystem::path(name).parent_path().string() + "/" + value;
+        }
+        return "";
+    }
+    // Имя файлов результатов без расширения вместо имени программы (задается после set_program)
+    void set_result_name(const string &name)
+    {
+        result_name = name;
+    }
+    // Замена форматов вывода, заданных директивами #output
+    void replace_output(const string &value)
+    {
+        output.clear();
+        set_output(value);
+    }
+    // Оценка объема памяти, занимаемой моделью (сетка, система уравнений и результаты)
+    size_t get_memory_size(void)
+    {
+        size_t size = mesh.get_memory_size() + solver.getMemorySize();
+
+        for (auto i = 0u; i < results.size(); i++)
+            size += results[i].get_size() * sizeof(double);
+        return size;
+    }
+    TMesh &get_mesh(void) noexcept
+    {
+        return mesh;
+    }
+    TResultList &get_results(void) noexcept
+    {
+        return results;
+    }
+    // Значения результата name по узлам без копирования (пустое представление, если результата нет)
+    TView<double> get_result(const string &name)
+    {
+        int i = results.index(name);
+
+        return i < 0 ? TView<double>() : TView<double>(results[unsigned(i)].get_results());
+    }
+    // Имена констант и нагрузок программы (параметров, которые могут задавать варианты расчета)
+    list<string> get_parameter_names(void) const
+    {
+        switch (mesh.get_type())
+        {
+        case FEType::fe1d2:
+            return parameter_names<TShape<TShape1d2>>();
+        case FEType::fe2d3:
+            return parameter_names<TShape<TShape2d3>>();
+        case FEType::fe2d4:
+            return parameter_names<TShape<TShape2d4>>();
+        case FEType::fe3d4:
+            return parameter_names<TShape<TShape3d4>>();
+        default:
+            throw TError(Message::IncorrectFE);
+        }
     }
     void start(void)
     {
@@ -220,7 +748,132 @@ public:
             throw TError(Message::IncorrectFE);
         }
     }
-    void save_result(string name)
+    // Разбор директивы "#sweep имя значение ..." или "#sweep имя начало:конец:количество"
+    static pair<string, vector<double>> parse_sweep(const string &value)
+    {
+        stringstream ss(value);
+        string name,
+               str;
+        vector<double> values;
+        auto number = [](const string &s)
+        {
+            size_t len = 0;
+            double ret = 0;
+
+            try
+            {
+                ret = stod(s, &len);
+            }
+            catch (exception&)
+            {
+                throw TError(Message::SweepFormat);
+            }
+            if (len not_eq s.length())
+                throw TError(Message::SweepFormat);
+            return ret;
+        };
+
+        ss >> name;
+        while (ss >> str)
+        {
+            size_t p = str.find(':'),
+                   q = (p == string::npos) ? p : str.find(':', p + 1);
+            double from,
+                   to,
+                   count;
+
+            if (p == string::npos)
+            {
+                values.push_back(number(str));
+                continue;
+            }
+            if (q == string::npos)
+                throw TError(Message::SweepFormat);
+            from = number(str.substr(0, p));
+            to = number(str.substr(p + 1, q - p - 1));
+            count = number(str.substr(q + 1));
+            if (count < 1 or count > 1000000 or count not_eq int(count))
+                throw TError(Message::SweepFormat);
+            for (auto i = 0; i < int(count); i++)
+                values.push_back(count == 1 ? from : from + (to - from) * i / (count - 1));
+        }
+        if (values.empty())
+            throw TError(Message::SweepFormat);
+        return { name, values };
+    }
+    // Параметр формата вывода: "float32", "meshref" (вместо сетки записывается ссылка на файл сетки
+    // и хеш его содержимого; сетка, заданная в памяти, записывается полностью) или "compress" (поблочное
+    // сжатие полей двоичного файла)
+    static bool has_option(const string &options, const string &name)
+    {
+        stringstream ss(options);
+        string str;
+
+        while (ss >> str)
+            if (str == name)
+                return true;
+        return false;
+    }
+    // Количество частей файла VTK (по умолчанию - один файл .vtu)
+    static unsigned vtu_pieces(const string &options)
+    {
+        size_t pos = options.find_first_not_of(" \t");
+
+        if (pos == string::npos)
+            return 1;
+        if (options.find_first_not_of("0123456789 \t") not_eq string::npos or options.length() - pos > 6)
+            throw TError(Message::OutputFormat);
+        return max(1u, unsigned(stoul(options.substr(pos))));
+    }
+    // Формат вывода: "text [meshref]" (по умолчанию - "text"), "binary [float32] [meshref] [compress]" или "vtu [число частей]"
+    void set_output(string value)
+    {
+        string format = value.substr(0, value.find_first_of(" \t"));
+
+        if (format not_eq "text" and format not_eq "binary" and format not_eq "vtu")
+            throw TError(Message::OutputFormat);
+        if (format == "vtu")
+            vtu_pieces(value.substr(format.length()));
+        output.push_back({ format, value.substr(format.length()) });
+    }
+    // Запись результатов во всех заданных форматах
+    void save_results(void)
+    {
+        string name = get_result_name();
+
+        if (output.empty())
+            save_result(name + ".res");
+        for (auto &[format, options]: output)
+            if (format == "text")
+                save_result(name + ".res", has_option(options, "meshref"));
+            else if (format == "binary")
+                save_binary_result(name + ".bres", has_option(options, "float32"), has_option(options, "meshref"), has_option(options, "compress"));
+        save_vtu();
+    }
+    // Запись результатов в двоичном формате (см. resfile.h)
+    void save_binary_result(string name, bool is_float = false, bool is_ref = false, bool is_compressed = false)
+    {
+        TResultFile out;
+        TProgress progress;
+
+        try
+        {
+            progress.set_process(Message::WritingResult);
+            out.open(name, is_float, is_compressed);
+            if (is_ref)
+                mesh.write_ref(out, filesystem::path(name).parent_path().string());
+            else
+                mesh.write(out);
+            results.write(out);
+            progress.stop();
+        }
+        catch (fstream::failure&)
+        {
+            progress.stop();
+            throw TError(Message::ReadFile);
+        }
+    }
+    void save_result(string name, bool is_ref = false)
     {
         ofstream out;
         TProgress progress;
@@ -233,9 +886,12 @@ public:
 
             progress.set_process(Message::WritingResult);
             // Запись подписи
-            out << "FEM Solver Results File" << endl;
-            // Запись сетки
-            mesh.write(out);
+            out << "FEM Solver Results File" << '\n';
+            // Запись сетки или ссылки на ее файл
+            if (is_ref)
+                mesh.write_ref(out, filesystem::path(name).parent_path().string());
+            else
+                mesh.write(out);
             // Запись результатов
             results.write(out);
             out.close();
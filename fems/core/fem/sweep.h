@@ -0,0 +1,317 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "fem/fem.h"
+#include "thread/workers.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Параметрический расчет: одна программа для набора вариантов значений констант
+// и нагрузок (директивы #sweep программы и/или файлы параметров .qfpf).
+// Сетка считывается один раз; каждый поток рассчитывает свою очередь вариантов
+// одной моделью, поэтому структура матрицы и ее символьный анализ выполняются
+// в потоке однократно, а для каждого варианта - только численное формирование и
+// разложение матрицы (для вариантов, отличающихся лишь нагрузками, - только правая часть).
+// Число потоков ограничивается объемом памяти, занимаемой моделями (fems --memory <Мб>, по умолчанию - 1 Гб).
+//
+// Результаты всех вариантов записываются в один файл <программа>.bres (время поля -
+// номер варианта), значения параметров вариантов - в <программа>.sweep
+//-----------------------------------------------------------------------
+template <class S> class TSweep
+{
+private:
+    // Модель с загруженной программой и сеткой
+    TFEM<S> &fem;
+    string prog_name;
+    // Ограничение объема памяти моделей (байт)
+    size_t capacity;
+    unsigned workers;
+    // Значения параметров вариантов
+    vector<list<pair<string, double>>> variants;
+    TResultFile out;
+    TProgress progress;
+    mutex mtx;
+    atomic<size_t> next{0};
+    exception_ptr error;
+    // Расчет очередных вариантов моделью model
+    void work(TFEM<S> *model)
+    {
+        try
+        {
+            for (size_t i; (i = next++) < variants.size();)
+            {
+                model->set_parameters(variants[i]);
+                model->start();
+                save(*model, i);
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(mtx);
+
+            // Остальные потоки завершаются после текущего варианта
+            next = variants.size();
+            if (not error)
+                error = current_exception();
+        }
+    }
+    // Запись результатов варианта i
+    void save(TFEM<S> &model, size_t i)
+    {
+        lock_guard<mutex> lock(mtx);
+        auto &results = model.get_results();
+
+        try
+        {
+            for (auto k = 0u; k < results.size(); k++)
+                out.write_result(results[k].get_name(), double(i), results[k].get_results());
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+        progress.add_progress();
+    }
+    // Варианты - все сочетания значений из диапазонов ranges (для каждого уже заданного набора параметров)
+    void set_ranges(const list<pair<string, vector<double>>> &ranges)
+    {
+        if (variants.empty())
+            variants.resize(1);
+        for (auto &[name, values]: ranges)
+        {
+            vector<list<pair<string, double>>> res;
+
+            for (auto &it: variants)
+                for (auto val: values)
+                {
+                    res.push_back(it);
+                    res.back().push_back({ name, val });
+                }
+            variants = move(res);
+        }
+    }
+    // Таблица вариантов: номер и пары "имя значение"
+    void write_index(const string &name)
+    {
+        ofstream index(name);
+
+        if (not index.is_open())
+            throw TError(Message::ReadFile);
+        index.precision(16);
+        for (auto i = 0u; i < variants.size(); i++)
+        {
+            index << i;
+            for (auto &[param, val]: variants[i])
+                index << ' ' << param << ' ' << val;
+            index << '\n';
+        }
+        if (index.fail())
+            throw TError(Message::ReadFile);
+    }
+public:
+    TSweep(TFEM<S> &f, const string &name, unsigned w = TWorkers::count(), size_t c = size_t(1) << 30) noexcept :
+        fem{f}, prog_name{name}, capacity{c}, workers{max(1u, w)} {}
+    ~TSweep(void) noexcept = default;
+    // Набор параметров из файла .qfpf: значения констант и нагрузок, заданные условиями списка
+    // Parameters.BoundaryConditions (модуль упругости E, коэффициент Пуассона m, толщина h и объемная
+    // нагрузка X, Y, Z), и строки "имя значение" списка Parameters.Variables. Параметры, не объявленные
+    // в программе (например, точность решения eps), и условия, не сводящиеся к значению константы
+    // или нагрузки, пропускаются с сообщением
+    void add_parameters(const string &name)
+    {
+        ifstream in(name);
+        stringstream ss;
+        string text;
+        list<string> names = fem.get_parameter_names();
+        list<pair<string, double>> params;
+        bool is_found = false;
+        size_t pos;
+        // Добавление параметра (или сообщение о его пропуске)
+        auto add = [&](const string &param, const string &value)
+        {
+            size_t len = 0;
+            double val = 0;
+
+            try
+            {
+                val = stod(value, &len);
+            }
+            catch (exception&)
+            {
+                len = 0;
+            }
+            if (len and len == value.length() and find(names.begin(), names.end(), param) not_eq names.end())
+                params.push_back({ param, val });
+            else
+                cout << say_message(Message::SkippedParameter) << param << ' ' << value << endl;
+        };
+        // Значение поля key объекта JSON text[begin, end) (строка - без кавычек)
+        auto field = [&text](size_t begin, size_t end, const string &key)
+        {
+            size_t pos = text.find('"' + key + '"', begin),
+                   last;
+
+            if (pos >= end or (pos = text.find_first_not_of(" \t\r\n:", pos + key.length() + 2)) >= end)
+                throw TError(Message::SweepFormat);
+            if (text[pos] == '"')
+            {
+                if ((last = text.find('"', pos + 1)) >= end)
+                    throw TError(Message::SweepFormat);
+                return text.substr(pos + 1, last - pos - 1);
+            }
+            return text.substr(pos, text.find_first_of(",}\r\n", pos) - pos);
+        };
+
+        if (not in.is_open())
+            throw TError(Message::ReadFile);
+        ss << in.rdbuf();
+        text = ss.str();
+        if ((pos = text.find("\"BoundaryConditions\"")) not_eq string::npos)
+        {
+            if ((pos = text.find_first_not_of(" \t\r\n:", pos + 20)) == string::npos or text[pos] not_eq '[')
+                throw TError(Message::SweepFormat);
+            while ((pos = text.find_first_not_of(" \t\r\n,", pos + 1)) not_eq string::npos and text[pos] == '{')
+            {
+                size_t end = text.find('}', pos);
+                string expression,
+                       predicate;
+                int type,
+                    direct;
+
+                if (end == string::npos)
+                    throw TError(Message::SweepFormat);
+                expression = field(pos, end, "Expression");
+                predicate = field(pos, end, "Predicate");
+                type = atoi(field(pos, end, "Type").c_str());
+                direct = atoi(field(pos, end, "Direct").c_str());
+                switch (type)
+                {
+                // Начальные и граничные условия задаются предикатами программы
+                case 1:
+                case 2:
+                    break;
+                case 3:
+                    for (auto i = 0; i < 3; i++)
+                        if (direct & (1 << i))
+                            add(predicate.empty() ? string(1, char('X' + i)) : string(1, char('X' + i)) + '(' + predicate + ')', expression);
+                    break;
+                case 7:
+                    add("E", expression);
+                    break;
+                case 8:
+                    add("m", expression);
+                    break;
+                case 9:
+                    add("h", expression);
+                    break;
+                default:
+                    add(predicate.empty() ? "#" + to_string(type) : "#" + to_string(type) + '(' + predicate + ')', expression);
+                }
+                pos = end;
+            }
+            if (pos == string::npos or text[pos] not_eq ']')
+                throw TError(Message::SweepFormat);
+            is_found = true;
+        }
+        if ((pos = text.find("\"Variables\"")) not_eq string::npos)
+        {
+            if ((pos = text.find_first_not_of(" \t\r\n:", pos + 11)) == string::npos or text[pos] not_eq '[')
+                throw TError(Message::SweepFormat);
+            while ((pos = text.find_first_not_of(" \t\r\n,", pos + 1)) not_eq string::npos and text[pos] == '"')
+            {
+                size_t end = text.find('"', pos + 1);
+                stringstream var;
+                string param,
+                       value;
+
+                if (end == string::npos)
+                    throw TError(Message::SweepFormat);
+                var.str(text.substr(pos + 1, end - pos - 1));
+                if (not (var >> param >> value) or not var.eof())
+                    throw TError(Message::SweepFormat);
+                add(param, value);
+                pos = end;
+            }
+            if (pos == string::npos or text[pos] not_eq ']')
+                throw TError(Message::SweepFormat);
+            is_found = true;
+        }
+        if (not is_found)
+            throw TError(Message::SweepFormat);
+        variants.push_back(params);
+    }
+    void start(void)
+    {
+        string name = prog_name.substr(0, prog_name.find_last_of("."));
+        vector<unique_ptr<TFEM<S>>> models;
+        vector<thread> pool;
+        bool is_float = false,
+             is_ref = false,
+             is_compressed = false;
+        size_t count;
+
+        set_ranges(fem.get_sweep());
+        for (auto &[format, options]: fem.get_output())
+            if (format == "binary")
+            {
+                is_float = TFEM<S>::has_option(options, "float32");
+                is_ref = TFEM<S>::has_option(options, "meshref");
+                is_compressed = TFEM<S>::has_option(options, "compress");
+            }
+        // Модели получают программу без директив (результаты вариантов остаются в памяти),
+        // но с параметрами кэша, хранения матрицы и бюджета памяти разложения
+        fem.set_variant(fem);
+        write_index(name + ".sweep");
+        try
+        {
+            out.open(name + ".bres", is_float, is_compressed);
+            if (is_ref)
+                fem.get_mesh().write_ref(out, filesystem::path(name).parent_path().string());
+            else
+                fem.get_mesh().write(out);
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+
+        progress.set_process(Message::CalculatingVariants, 1, variants.size());
+        // Первый вариант определяет объем памяти модели и, следовательно, число потоков
+        next = 1;
+        fem.set_parameters(variants[0]);
+        fem.start();
+        save(fem, 0);
+        count = min({ size_t(workers), max(size_t(1), capacity / max(size_t(1), fem.get_memory_size())), variants.size() - 1 });
+        for (auto i = 1u; i < count; i++)
+        {
+            models.push_back(make_unique<TFEM<S>>());
+            models.back()->set_mesh(fem.get_mesh());
+            models.back()->set_variant(fem);
+        }
+        for (auto &it: models)
+            pool.push_back(thread(&TSweep::work, this, it.get()));
+        work(&fem);
+        for (auto &it: pool)
+            it.join();
+        if (error)
+            rethrow_exception(error);
+        try
+        {
+            out.close(int64_t(time(nullptr)));
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+        progress.stop_process();
+    }
+};
+
+#endif // SWEEP_H
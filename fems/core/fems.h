@@ -0,0 +1,17 @@
+#ifndef FEMS_H
+#define FEMS_H
+
+//-----------------------------------------------------------------------
+// Интерфейс библиотеки FEM Solver
+//
+//  TFEM<TEigenSolver> fem;
+//  fem.set_mesh("fe3d4", x, fe, be);   // или директива #mesh в программе
+//  fem.set_program_text(program);      // или set_program(<файл .prg>)
+//  fem.start();
+//  TView<double> w = fem.get_result("w");
+//-----------------------------------------------------------------------
+#include "solver/eigensolver.h"
+#include "fem/fem.h"
+#include "fem/sweep.h"
+
+#endif // FEMS_H
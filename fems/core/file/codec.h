@@ -0,0 +1,154 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Сжатие блока данных: перестановка байтов (сначала младшие байты всех
+// значений, затем следующие и т.д.) и кодирование LZ77 в формате блока LZ4
+//-----------------------------------------------------------------------
+class TBlockCodec
+{
+private:
+    // Параметры формата LZ4: минимальная длина совпадения, последние 5 байт - всегда литералы,
+    // последнее совпадение начинается не ближе 12 байт от конца
+    static constexpr size_t min_match = 4;
+    static constexpr size_t last_literals = 5;
+    static constexpr size_t match_limit = 12;
+    static constexpr unsigned hash_log = 14;
+    static uint32_t read32(const uint8_t *p) noexcept
+    {
+        uint32_t val;
+
+        memcpy(&val, p, sizeof(val));
+        return val;
+    }
+    static uint8_t *write_length(uint8_t *op, size_t len) noexcept
+    {
+        for (; len >= 255; len -= 255)
+            *op++ = 255;
+        *op++ = uint8_t(len);
+        return op;
+    }
+    static uint8_t *write_literals(uint8_t *op, const uint8_t *src, size_t len, size_t match) noexcept
+    {
+        *op++ = uint8_t((len < 15 ? len : 15) << 4 | (match < 15 ? match : 15));
+        if (len >= 15)
+            op = write_length(op, len - 15);
+        if (len)
+            memcpy(op, src, len);
+        return op + len;
+    }
+    static bool read_length(const uint8_t *&ip, const uint8_t *end, size_t &len) noexcept
+    {
+        uint8_t val;
+
+        do
+        {
+            if (ip == end)
+                return false;
+            len += (val = *ip++);
+        }
+        while (val == 255);
+        return true;
+    }
+public:
+    // Максимальный размер сжатого блока
+    static size_t bound(size_t size) noexcept
+    {
+        return size + size / 255 + 16;
+    }
+    static void shuffle(const uint8_t *src, uint8_t *dst, size_t count, size_t elem) noexcept
+    {
+        for (size_t i = 0; i < count; i++)
+            for (size_t j = 0; j < elem; j++)
+                dst[j * count + i] = src[i * elem + j];
+    }
+    static void unshuffle(const uint8_t *src, uint8_t *dst, size_t count, size_t elem) noexcept
+    {
+        for (size_t j = 0; j < elem; j++)
+            for (size_t i = 0; i < count; i++)
+                dst[i * elem + j] = src[j * count + i];
+    }
+    // Сжатие size байт src в dst (не менее bound(size) байт); возвращает размер результата
+    static size_t compress(const uint8_t *src, size_t size, uint8_t *dst)
+    {
+        vector<uint32_t> table(size_t(1) << hash_log, 0);
+        size_t ip = 0,
+               anchor = 0;
+        uint8_t *op = dst;
+
+        while (size > match_limit and ip < size - match_limit)
+        {
+            uint32_t seq = read32(src + ip),
+                     h = (seq * 2654435761u) >> (32 - hash_log);
+            size_t ref = table[h],
+                   len = min_match;
+
+            table[h] = uint32_t(ip);
+            if (ref >= ip or ip - ref > 65535 or read32(src + ref) not_eq seq)
+            {
+                // На несжимаемых участках шаг поиска увеличивается
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip + len < size - last_literals and src[ref + len] == src[ip + len])
+                len++;
+            op = write_literals(op, src + anchor, ip - anchor, len - min_match);
+            *op++ = uint8_t(ip - ref);
+            *op++ = uint8_t((ip - ref) >> 8);
+            if (len - min_match >= 15)
+                op = write_length(op, len - min_match - 15);
+            ip += len;
+            anchor = ip;
+        }
+        // Последняя последовательность содержит только литералы
+        op = write_literals(op, src + anchor, size - anchor, 0);
+        return size_t(op - dst);
+    }
+    // Восстановление ровно size байт в dst; false - поврежденные данные
+    static bool decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t size) noexcept
+    {
+        const uint8_t *ip = src,
+                      *end = src + src_size;
+        size_t op = 0;
+
+        while (ip < end)
+        {
+            uint8_t token = *ip++;
+            size_t len = token >> 4,
+                   offset;
+
+            if (len == 15 and not read_length(ip, end, len))
+                return false;
+            if (len > size_t(end - ip) or len > size - op)
+                return false;
+            if (len)
+                memcpy(dst + op, ip, len);
+            ip += len;
+            op += len;
+            if (ip == end)
+                break;
+            if (end - ip < 2)
+                return false;
+            offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+            ip += 2;
+            len = token & 15;
+            if (len == 15 and not read_length(ip, end, len))
+                return false;
+            len += min_match;
+            if (offset == 0 or offset > op or len > size - op)
+                return false;
+            // Области могут перекрываться - копирование побайтно
+            for (size_t i = 0; i < len; i++, op++)
+                dst[op] = dst[op - offset];
+        }
+        return op == size;
+    }
+};
+
+#endif // CODEC_H
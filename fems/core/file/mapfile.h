@@ -0,0 +1,102 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Отображение файла в память только для чтения
+// (при отсутствии mmap файл целиком считывается в буфер)
+//-----------------------------------------------------------------------
+class TMappedFile
+{
+private:
+    const char *ptr = nullptr;
+    size_t len = 0;
+#ifdef _WIN32
+    vector<char> buffer;
+#endif
+public:
+    TMappedFile(void) noexcept {}
+    TMappedFile(const TMappedFile&) = delete;
+    TMappedFile &operator = (const TMappedFile&) = delete;
+    ~TMappedFile(void) noexcept
+    {
+        close();
+    }
+    bool open(const string &name)
+    {
+        close();
+#ifndef _WIN32
+        struct stat st;
+        int fd = ::open(name.c_str(), O_RDONLY);
+        void *addr;
+
+        if (fd < 0)
+            return false;
+        if (fstat(fd, &st) not_eq 0 or st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        addr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+        ptr = static_cast<const char*>(addr);
+        len = size_t(st.st_size);
+#else
+        ifstream in(name, ios::binary | ios::ate);
+
+        if (not in.is_open())
+            return false;
+        buffer.resize(size_t(in.tellg()));
+        in.seekg(0);
+        if (not in.read(buffer.data(), streamsize(buffer.size())) or buffer.empty())
+            return false;
+        ptr = buffer.data();
+        len = buffer.size();
+#endif
+        return true;
+    }
+    void close(void) noexcept
+    {
+#ifndef _WIN32
+        if (ptr)
+            munmap(const_cast<char*>(ptr), len);
+#else
+        buffer.clear();
+        buffer.shrink_to_fit();
+#endif
+        ptr = nullptr;
+        len = 0;
+    }
+    bool is_open(void) const noexcept
+    {
+        return ptr not_eq nullptr;
+    }
+    const char *data(void) const noexcept
+    {
+        return ptr;
+    }
+    size_t size(void) const noexcept
+    {
+        return len;
+    }
+    // Указатель на данные по смещению с проверкой выхода за границы файла
+    template <typename T> const T *at(size_t offset, size_t count = 1) const noexcept
+    {
+        return (offset <= len and count <= (len - offset) / sizeof(T) and offset % alignof(T) == 0) ? reinterpret_cast<const T*>(ptr + offset) : nullptr;
+    }
+};
+
+#endif // MAPFILE_H
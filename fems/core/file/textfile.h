@@ -0,0 +1,95 @@
+#ifndef TEXTFILE_H
+#define TEXTFILE_H
+
+#include <charconv>
+#include <string>
+#include <vector>
+#include <thread>
+#include <ostream>
+#include <algorithm>
+#include "thread/workers.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Быстрый вывод числовых таблиц в текстовый поток: значения форматируются
+// to_chars (результат совпадает с operator << при тех же precision и
+// floatfield в локали "C") параллельно по блокам строк, а каждый блок
+// записывается одним вызовом write
+//-----------------------------------------------------------------------
+class TTextTable
+{
+private:
+    // Количество значений в блоке, форматируемом одним потоком
+    static constexpr size_t chunk_size = size_t(1) << 16;
+    static char *format(char *first, char *last, double val, chars_format fmt, int precision)
+    {
+        return to_chars(first, last, val, fmt, precision).ptr;
+    }
+    template <typename T> static char *format(char *first, char *last, T val, chars_format, int)
+    {
+        return to_chars(first, last, val).ptr;
+    }
+    template <typename T> static void format_chunk(string &buffer, const T *data, size_t first_row, size_t last_row, size_t cols, const char *sep, chars_format fmt, int precision)
+    {
+        size_t sep_len = char_traits<char>::length(sep),
+               width = size_t(max(24, precision + 10)) + (fmt == chars_format::fixed ? 310 : 0);
+        char *ptr;
+
+        // Запас на одно значение: знак, цифры мантиссы, точка, порядок (для fixed - все цифры целой части)
+        buffer.resize((last_row - first_row) * (cols * (width + sep_len) + 1));
+        ptr = buffer.data();
+        for (auto i = first_row; i < last_row; i++)
+        {
+            for (auto j = 0u; j < cols; j++)
+            {
+                ptr = format(ptr, buffer.data() + buffer.size(), data[i * cols + j], fmt, precision);
+                for (auto k = 0u; k < sep_len; k++)
+                    *ptr++ = sep[k];
+            }
+            *ptr++ = '\n';
+        }
+        buffer.resize(size_t(ptr - buffer.data()));
+    }
+public:
+    // Вывод таблицы rows x cols: за каждым значением следует sep, за каждой строкой - перевод строки
+    template <typename T> static void write(ostream &out, const T *data, size_t rows, size_t cols, const char *sep = "")
+    {
+        chars_format fmt = chars_format::general;
+        int precision = int(out.precision());
+        size_t rows_per_chunk = max(size_t(1), chunk_size / max(size_t(1), cols)),
+               chunks = (rows + rows_per_chunk - 1) / rows_per_chunk,
+               workers = TWorkers::count();
+        vector<string> buffer(min(chunks, workers));
+        vector<thread> pool;
+
+        if ((out.flags() & ios::floatfield) == ios::fixed)
+            fmt = chars_format::fixed;
+        else if ((out.flags() & ios::floatfield) == ios::scientific)
+            fmt = chars_format::scientific;
+        // Блоки обрабатываются группами по числу потоков, чтобы ограничить объем буферов
+        for (size_t first = 0; first < chunks; first += buffer.size())
+        {
+            size_t count = min(buffer.size(), chunks - first);
+
+            pool.clear();
+            for (size_t k = 0; k < count; k++)
+            {
+                size_t first_row = (first + k) * rows_per_chunk,
+                       last_row = min(rows, first_row + rows_per_chunk);
+
+                if (count == 1)
+                    format_chunk(buffer[k], data, first_row, last_row, cols, sep, fmt, precision);
+                else
+                    pool.push_back(thread([&buffer, k, data, first_row, last_row, cols, sep, fmt, precision]
+                                          { format_chunk(buffer[k], data, first_row, last_row, cols, sep, fmt, precision); }));
+            }
+            for (auto &it: pool)
+                it.join();
+            for (size_t k = 0; k < count; k++)
+                out.write(buffer[k].data(), streamsize(buffer[k].size()));
+        }
+    }
+};
+
+#endif // TEXTFILE_H
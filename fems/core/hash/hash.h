@@ -0,0 +1,85 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "matrix/matrix.h"
+#include "matrix/packed.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Хеш-сумма содержимого (FNV-1a, 64 бита) для идентификации данных
+//-----------------------------------------------------------------------
+class THash
+{
+private:
+    uint64_t hash = 14695981039346656037ull;
+public:
+    THash(void) noexcept {}
+    ~THash(void) noexcept = default;
+    THash &add(const void *data, size_t size) noexcept
+    {
+        auto p = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        return *this;
+    }
+    THash &add(const string &str) noexcept
+    {
+        // Длина добавляется для однозначности последовательности строк
+        add(str.length());
+        return add(str.data(), str.length());
+    }
+    template <typename T> THash &add(T val) noexcept
+    {
+        return add(&val, sizeof(T));
+    }
+    template <typename T> THash &add(matrix<T> &m) noexcept
+    {
+        add(m.size1());
+        add(m.size2());
+        return add(m.data(), m.size1() * m.size2() * sizeof(T));
+    }
+    // Значения в типе T (хеш не зависит от типа хранения)
+    template <typename T, typename... S> THash &add(TPackedMatrix<T, S...> &m)
+    {
+        add(m.size1());
+        add(m.size2());
+        m.template for_rows<T>(0, m.size1(), [this, &m](const T *p, size_t n) { add(p, n * m.size2() * sizeof(T)); });
+        return *this;
+    }
+    bool add_file(const string &name)
+    {
+        vector<char> buffer(1 << 20);
+        ifstream in(name, ios::binary);
+
+        if (not in.is_open())
+            return false;
+        while (in.read(buffer.data(), streamsize(buffer.size())) or in.gcount())
+            add(buffer.data(), size_t(in.gcount()));
+        return not in.bad();
+    }
+    uint64_t value(void) const noexcept
+    {
+        return hash;
+    }
+    string str(void) const
+    {
+        return str(hash);
+    }
+    static string str(uint64_t val)
+    {
+        stringstream ss;
+
+        ss << hex << setw(16) << setfill('0') << val;
+        return ss.str();
+    }
+};
+
+#endif // HASH_H
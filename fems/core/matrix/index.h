@@ -0,0 +1,16 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+//-----------------------------------------------------------------------
+// Тип номеров узлов, КЭ, степеней свободы и ненулевых элементов глобальной матрицы.
+// По умолчанию - 32 бита; для моделей с более чем 2^31 ненулевыми элементами матрицы
+// ядро собирается с 64-битными индексами (qmake CONFIG+=index64, определяет FEMS_INDEX64).
+// 64-битный тип - long long, как у 64-битного интерфейса Pardiso
+//-----------------------------------------------------------------------
+#ifdef FEMS_INDEX64
+using TIndex = long long;
+#else
+using TIndex = int;
+#endif
+
+#endif // INDEX_H
@@ -0,0 +1,131 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <limits>
+#include <vector>
+#include <variant>
+#include <cstdint>
+#include <algorithm>
+#include "matrix/matrix.h"
+#include "matrix/index.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Матрица значений типа T, хранящихся в T или в одном из более узких типов S (от узкого к широкому).
+// Тип хранения выбирается до заполнения (set_storage); чтение всегда возвращает T
+//-----------------------------------------------------------------------
+template <typename T, typename... S> class TPackedMatrix
+{
+private:
+    size_t rows = 0;
+    size_t cols = 0;
+    variant<vector<T>, vector<S>...> buffer;
+    // Наиболее узкий тип хранения, вмещающий значения до range
+    template <size_t K = 1> void select(T range)
+    {
+        if constexpr (K < sizeof...(S) + 1)
+        {
+            using N = typename variant_alternative_t<K, decltype(buffer)>::value_type;
+
+            if (double(range) <= double(numeric_limits<N>::max()))
+                buffer.template emplace<K>();
+            else
+                select<K + 1>(range);
+        }
+        else
+            buffer.template emplace<0>();
+    }
+public:
+    TPackedMatrix(void) noexcept {}
+    ~TPackedMatrix(void) noexcept = default;
+    // Тип хранения (содержимое очищается): is_compact - наиболее узкий тип, вмещающий значения
+    // до range (для вещественных типов - наиболее узкий из S), иначе - T
+    void set_storage(bool is_compact, T range = T())
+    {
+        rows = cols = 0;
+        if (is_compact)
+            select(range);
+        else
+            buffer.template emplace<0>();
+    }
+    void resize(size_t r, size_t c)
+    {
+        rows = r;
+        cols = c;
+        visit([this](auto &v) { v.resize(rows * cols); }, buffer);
+    }
+    size_t size1(void) const noexcept
+    {
+        return rows;
+    }
+    size_t size2(void) const noexcept
+    {
+        return cols;
+    }
+    // Размер элемента в памяти (байт)
+    size_t width(void) const noexcept
+    {
+        return visit([](const auto &v) { return sizeof(v[0]); }, buffer);
+    }
+    size_t memory_size(void) const noexcept
+    {
+        return rows * cols * width();
+    }
+    T operator () (size_t i, size_t j) const
+    {
+        return visit([k = i * cols + j](const auto &v) { return T(v[k]); }, buffer);
+    }
+    void set(size_t i, size_t j, T val)
+    {
+        visit([k = i * cols + j, val](auto &v) { v[k] = typename decay_t<decltype(v)>::value_type(val); }, buffer);
+    }
+    // Вызов f(p) для указателя p на начало данных в типе хранения (заполнение и преобразование без копирования)
+    template <typename F> auto apply(F f)
+    {
+        return visit([&f](auto &v) { return f(v.data()); }, buffer);
+    }
+    // Строка i, преобразованная к типу U
+    template <typename U> void get_row(size_t i, U *dst) const
+    {
+        visit([this, i, dst](const auto &v) { copy_n(v.data() + i * cols, cols, dst); }, buffer);
+    }
+    // Вызов f(p, n) для последовательных частей строк [first, first + count), преобразованных к типу U
+    // (если тип хранения совпадает с U - один вызов для всех строк без копирования)
+    template <typename U, typename F> void for_rows(size_t first, size_t count, F f) const
+    {
+        visit([this, first, count, &f](const auto &v)
+        {
+            if constexpr (is_same_v<typename decay_t<decltype(v)>::value_type, U>)
+                f(v.data() + first * cols, count);
+            else
+            {
+                size_t part = max(size_t(1), (size_t(1) << 16) / max(size_t(1), cols));
+                vector<U> tmp;
+
+                for (size_t i = first, n; i < first + count; i += n)
+                {
+                    n = min(part, first + count - i);
+                    tmp.assign(v.data() + i * cols, v.data() + (i + n) * cols);
+                    f(tmp.data(), n);
+                }
+            }
+        }, buffer);
+    }
+    template <typename U> void copy_to(matrix<U> &m) const
+    {
+        m.resize(rows, cols);
+        visit([&m](const auto &v) { copy(v.begin(), v.end(), m.data()); }, buffer);
+    }
+};
+
+// Хранение сетки (см. TMesh::set_compact): координаты узлов - double или float, номера узлов -
+// наиболее узкий целый тип, вмещающий номер последнего узла
+using TCoordTable = TPackedMatrix<double, float>;
+#ifdef FEMS_INDEX64
+using TIndexTable = TPackedMatrix<TIndex, uint16_t, uint32_t>;
+#else
+using TIndexTable = TPackedMatrix<TIndex, uint16_t>;
+#endif
+
+#endif // PACKED_H
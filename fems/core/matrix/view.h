@@ -0,0 +1,49 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Представление непрерывного массива без владения данными
+// (входные массивы библиотеки и доступ к результатам без копирования)
+//-----------------------------------------------------------------------
+template <typename T> class TView
+{
+private:
+    const T *ptr = nullptr;
+    size_t len = 0;
+public:
+    TView(void) noexcept {}
+    TView(const T *p, size_t n) noexcept : ptr{p}, len{n} {}
+    TView(const vector<T> &v) noexcept : ptr{v.data()}, len{v.size()} {}
+    ~TView(void) noexcept = default;
+    const T *data(void) const noexcept
+    {
+        return ptr;
+    }
+    size_t size(void) const noexcept
+    {
+        return len;
+    }
+    bool empty(void) const noexcept
+    {
+        return len == 0;
+    }
+    const T &operator [] (size_t i) const noexcept
+    {
+        return ptr[i];
+    }
+    const T *begin(void) const noexcept
+    {
+        return ptr;
+    }
+    const T *end(void) const noexcept
+    {
+        return ptr + len;
+    }
+};
+
+#endif // VIEW_H
@@ -0,0 +1,324 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <array>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include "msg/msg.h"
+#include "file/textfile.h"
+#include "mesh/meshfile.h"
+#include "thread/workers.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Генератор регулярных сеток для тестирования производительности:
+//  fe1d2 - стержень из n[0] КЭ;
+//  fe2d3, fe2d4 - прямоугольник из n[0] x n[1] четырехугольников (fe2d3 - по 2 треугольника);
+//  fe3d4 - параллелепипед из n[0] x n[1] x n[2] шестигранников, каждый разбит на 6 тетраэдров
+//          вдоль общей диагонали (разбиение согласовано между соседними шестигранниками).
+// Внутренние узлы могут быть случайно смещены (perturbation - доля шага сетки, не более 0.25);
+// узлы на границе не смещаются, поэтому граничные условия вида x == 0 остаются точными.
+// Смещение узла зависит только от seed и номера узла, поэтому сетка не зависит от числа потоков
+//-----------------------------------------------------------------------
+class TMeshGenerator
+{
+private:
+    string type;
+    unsigned dim = 0,
+             fe_size = 0,
+             be_size = 0;
+    // Число шагов по осям (0 - ось не используется)
+    array<size_t, 3> n{ 0, 0, 0 };
+    array<double, 3> length{ 1, 1, 1 };
+    double perturbation = 0;
+    uint64_t seed = 1;
+    vector<double> x;
+    vector<TIndex> fe;
+    vector<TIndex> be;
+    // Обработка диапазона [0, count) частями по числу потоков
+    template <typename F> static void parallel(size_t count, F f)
+    {
+        size_t workers = min(size_t(TWorkers::count()), max(size_t(1), count / 4096));
+        vector<thread> pool;
+
+        for (size_t k = 1; k < workers; k++)
+            pool.push_back(thread(f, count * k / workers, count * (k + 1) / workers));
+        f(0, count / workers);
+        for (auto &it: pool)
+            it.join();
+    }
+    // Псевдослучайное число в [-1, 1) для узла i и координаты k (splitmix64)
+    double random(size_t i, unsigned k) const noexcept
+    {
+        uint64_t z = seed + (uint64_t(i) * 3 + k + 1) * 0x9E3779B97F4A7C15ull;
+
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        return double(z >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+    }
+    TIndex node(size_t i, size_t j = 0, size_t k = 0) const noexcept
+    {
+        return TIndex((k * (n[1] + 1) + j) * (n[0] + 1) + i);
+    }
+    void create_nodes(void)
+    {
+        size_t count = (n[0] + 1) * (n[1] + 1) * (n[2] + 1);
+
+        x.resize(count * dim);
+        parallel(count, [this](size_t first, size_t last)
+        {
+            for (auto p = first; p < last; p++)
+            {
+                array<size_t, 3> idx{ p % (n[0] + 1), p / (n[0] + 1) % (n[1] + 1), p / (n[0] + 1) / (n[1] + 1) };
+                bool is_inner = true;
+
+                for (auto k = 0u; k < dim; k++)
+                    is_inner = is_inner and idx[k] > 0 and idx[k] < n[k];
+                for (auto k = 0u; k < dim; k++)
+                    x[p * dim + k] = length[k] * double(idx[k]) / double(n[k]) + (is_inner ? perturbation * random(p, k) * length[k] / double(n[k]) : 0);
+            }
+        });
+    }
+    void create_elements(void)
+    {
+        size_t cells = n[0] * max(n[1], size_t(1)) * max(n[2], size_t(1)),
+               per_cell = (type == "fe2d3") ? 2 : (type == "fe3d4") ? 6 : 1;
+
+        fe.resize(cells * per_cell * fe_size);
+        parallel(cells, [this, per_cell](size_t first, size_t last)
+        {
+            // Тетраэдры шестигранника: пути от вершины 0 к вершине 7 по ребрам (номер вершины - i + 2j + 4k)
+            const int tet[6][4] = { { 0, 1, 3, 7 }, { 0, 1, 5, 7 }, { 0, 2, 3, 7 }, { 0, 2, 6, 7 }, { 0, 4, 5, 7 }, { 0, 4, 6, 7 } };
+
+            for (auto c = first; c < last; c++)
+            {
+                size_t i = c % n[0],
+                       j = c / n[0] % max(n[1], size_t(1)),
+                       k = c / n[0] / max(n[1], size_t(1));
+                TIndex *p = fe.data() + c * per_cell * fe_size,
+                       v[8];
+
+                for (auto l = 0u; l < 8; l++)
+                    v[l] = node(i + (l & 1), j + ((l >> 1) & 1), k + ((l >> 2) & 1));
+                if (type == "fe1d2")
+                    copy_n(array<TIndex, 2>{ v[0], v[1] }.begin(), 2, p);
+                else if (type == "fe2d3")
+                    copy_n(array<TIndex, 6>{ v[0], v[1], v[3], v[0], v[3], v[2] }.begin(), 6, p);
+                else if (type == "fe2d4")
+                    copy_n(array<TIndex, 4>{ v[0], v[1], v[3], v[2] }.begin(), 4, p);
+                else
+                    for (auto &t: tet)
+                        for (auto l = 0; l < 4; l++)
+                            *p++ = v[t[l]];
+            }
+        });
+    }
+    void create_boundary(void)
+    {
+        be.clear();
+        if (type == "fe1d2")
+            be = { node(0), node(n[0]) };
+        else if (dim == 2)
+        {
+            for (auto i = 0u; i < n[0]; i++)
+                be.insert(be.end(), { node(i, 0), node(i + 1, 0), node(i + 1, n[1]), node(i, n[1]) });
+            for (auto j = 0u; j < n[1]; j++)
+                be.insert(be.end(), { node(0, j + 1), node(0, j), node(n[0], j), node(n[0], j + 1) });
+        }
+        else
+            // Грани, перпендикулярные оси a: по 2 треугольника на каждый квадрат
+            for (auto a = 0u; a < 3; a++)
+            {
+                unsigned b = (a + 1) % 3,
+                         c = (a + 2) % 3;
+
+                for (auto s: { size_t(0), n[a] })
+                    for (auto p = 0u; p < n[b]; p++)
+                        for (auto q = 0u; q < n[c]; q++)
+                        {
+                            TIndex v[4];
+
+                            for (auto l = 0u; l < 4; l++)
+                            {
+                                array<size_t, 3> idx;
+
+                                idx[a] = s;
+                                idx[b] = p + ((l == 1 or l == 2) ? 1 : 0);
+                                idx[c] = q + ((l >= 2) ? 1 : 0);
+                                v[l] = node(idx[0], idx[1], idx[2]);
+                            }
+                            be.insert(be.end(), { v[0], v[1], v[2], v[0], v[2], v[3] });
+                        }
+            }
+    }
+public:
+    TMeshGenerator(void) noexcept {}
+    ~TMeshGenerator(void) noexcept = default;
+    // Тип КЭ, число шагов и размеры области по осям (используются первые dim значений)
+    void set_mesh(const string &t, const array<size_t, 3> &count, const array<double, 3> &len = { 1, 1, 1 })
+    {
+        // Тип КЭ, размерность, количество узлов КЭ и граничного элемента
+        const vector<tuple<string, unsigned, unsigned, unsigned>> table{ { "fe1d2", 1, 2, 1 }, { "fe2d3", 2, 3, 2 }, { "fe2d4", 2, 4, 2 }, { "fe3d4", 3, 4, 3 } };
+        auto it = find_if(table.begin(), table.end(), [t](const auto &i) { return get<0>(i) == t; });
+
+        if (it == table.end())
+            throw TError(Message::IncorrectFE);
+        tie(type, dim, fe_size, be_size) = *it;
+        n = { 0, 0, 0 };
+        length = { 1, 1, 1 };
+        for (auto k = 0u; k < dim; k++)
+        {
+            if (count[k] == 0 or len[k] <= 0)
+                throw TError(Message::MeshFormat);
+            n[k] = count[k];
+            length[k] = len[k];
+        }
+        if ((n[0] + 1) * (n[1] + 1) * (n[2] + 1) > size_t(numeric_limits<TIndex>::max()))
+            throw TError(Message::MeshFormat);
+    }
+    void set_perturbation(double p, uint64_t s = 1) noexcept
+    {
+        perturbation = max(0.0, min(p, 0.25));
+        seed = s;
+    }
+    void create(void)
+    {
+        create_nodes();
+        create_elements();
+        create_boundary();
+    }
+    const string &get_type(void) const noexcept
+    {
+        return type;
+    }
+    size_t get_nodes(void) const noexcept
+    {
+        return dim ? x.size() / dim : 0;
+    }
+    size_t get_fe_count(void) const noexcept
+    {
+        return fe_size ? fe.size() / fe_size : 0;
+    }
+    size_t get_be_count(void) const noexcept
+    {
+        return be_size ? be.size() / be_size : 0;
+    }
+    const vector<double> &get_x(void) const noexcept
+    {
+        return x;
+    }
+    const vector<TIndex> &get_fe(void) const noexcept
+    {
+        return fe;
+    }
+    const vector<TIndex> &get_be(void) const noexcept
+    {
+        return be;
+    }
+    // Запись в текстовом формате .trpa
+    void write_text(const string &name)
+    {
+        ofstream out;
+
+        out.exceptions(ofstream::failbit | ofstream::badbit);
+        try
+        {
+            out.open(name);
+            out.precision(17);
+            out << type << '\n' << x.size() / dim << '\n';
+            TTextTable::write(out, x.data(), x.size() / dim, dim, " ");
+            out << fe.size() / fe_size << '\n';
+            TTextTable::write(out, fe.data(), fe.size() / fe_size, fe_size, " ");
+            out << be.size() / be_size << '\n';
+            TTextTable::write(out, be.data(), be.size() / be_size, be_size, " ");
+            out.close();
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+    }
+    // Запись в двоичном формате (см. meshfile.h)
+    void write_binary(const string &name)
+    {
+        try
+        {
+            TMeshFile::write(name, type, x.data(), x.size() / dim, dim, fe.data(), fe.size() / fe_size, fe_size, be.data(), be.size() / be_size, be_size);
+        }
+        catch (fstream::failure&)
+        {
+            throw TError(Message::ReadFile);
+        }
+    }
+    // Программа расчета (упругость; закрепление при x == 0 или z == 0, собственный вес или сила на конце)
+    void write_program(const string &name, const string &mesh_name)
+    {
+        ofstream out(name);
+
+        if (not out.is_open())
+            throw TError(Message::ReadFile);
+        out.precision(17);
+        out << "#mesh " << mesh_name << '\n';
+        if (dim == 1)
+            out << "argument x\n"
+                   "result u\n"
+                   "constant E = 203200\n"
+                   "function Exx, Sxx\n"
+                   "load X = 0\n"
+                   "functional W\n\n"
+                   "Exx = diff(u, x)\n"
+                   "Sxx = E * Exx\n\n"
+                   "W = 0.5 * (integral(Sxx var Exx) - integral(X var u))\n\n"
+                   "u(x == 0) = 0\n\n"
+                   "X(x == " << length[0] << ") = 1\n";
+        else if (dim == 2)
+            out << "argument x, y\n"
+                   "result u, v\n"
+                   "constant E = 203200, m = 0.27, K = E / (1 - m * m), G = E / (2 + 2 * m)\n"
+                   "function Exx, Eyy, Exy, Sxx, Syy, Sxy\n"
+                   "load X = 0, Y = -1\n"
+                   "functional W\n\n"
+                   "Exx = diff(u, x)\n"
+                   "Eyy = diff(v, y)\n"
+                   "Exy = diff(u, y) + diff(v, x)\n\n"
+                   "Sxx = K * (Exx + m * Eyy)\n"
+                   "Syy = K * (m * Exx + Eyy)\n"
+                   "Sxy = G * Exy\n\n"
+                   "W = 0.5 * integral(Sxx var Exx + Syy var Eyy + Sxy var Exy) - integral(X var u + Y var v)\n\n"
+                   "u(x == 0) = 0\n"
+                   "v(x == 0) = 0\n";
+        else
+            out << "argument x, y, z\n"
+                   "result u, v, w\n"
+                   "constant E = 203200, m = 0.27, G = E / (2 + 2 * m), L = 2 * m * G / (1 - 2 * m)\n"
+                   "function Exx, Eyy, Ezz, Exy, Exz, Eyz, Sxx, Syy, Szz, Sxy, Sxz, Syz\n"
+                   "load X = 0, Y = 0, Z = 0.5\n"
+                   "functional W\n\n"
+                   "Exx = diff(u, x)\n"
+                   "Eyy = diff(v, y)\n"
+                   "Ezz = diff(w, z)\n"
+                   "Exy = diff(u, y) + diff(v, x)\n"
+                   "Exz = diff(u, z) + diff(w, x)\n"
+                   "Eyz = diff(v, z) + diff(w, y)\n\n"
+                   "Sxx = 2 * G * Exx + L * (Exx + Eyy + Ezz)\n"
+                   "Syy = 2 * G * Eyy + L * (Exx + Eyy + Ezz)\n"
+                   "Szz = 2 * G * Ezz + L * (Exx + Eyy + Ezz)\n"
+                   "Sxy = G * Exy\n"
+                   "Sxz = G * Exz\n"
+                   "Syz = G * Eyz\n\n"
+                   "W = 0.5 * integral(Sxx var Exx + Syy var Eyy + Szz var Ezz + Sxy var Exy + Sxz var Exz + Syz var Eyz) - integral(X var u + Y var w + Z var w)\n\n"
+                   "u(z == 0) = 0\n"
+                   "v(z == 0) = 0\n"
+                   "w(z == 0) = 0\n";
+        if (out.fail())
+            throw TError(Message::ReadFile);
+    }
+};
+
+#endif // GENERATOR_H
@@ -1,8 +1,14 @@
 #include <filesystem>
 #include <fstream>
 #include "mesh.h"
+#include "analyse/resfile.h"
 #include "msg/msg.h"
 #include "shape/shape.h"
+#include "file/textfile.h"
+#include "hash/hash.h"
+#include "trace/trace.h"
+#include "file/mapfile.h"
+#include "mesh/meshfile.h"
 
 // ------------- Определение параметров КЭ ----------------------
 FEType TMesh::decode_mesh_type(string type, int& be_size, int& fe_size, int& dim)
@@ -22,76 +28,296 @@ FEType TMesh::decode_mesh_type(string type, int& be_size, int& fe_size, int& dim
 
 void TMesh::set_mesh_file(string path, string name)
 {
-    string fetype;
-    int val,
-        fe_size,
+    read(filesystem::exists(name) ? name : path + "/" + name);
+    cout << *this << endl;
+    create_mesh_map();
+}
+
+// Сетка из массивов в памяти: координаты (по dim значений на узел), связность КЭ и граничные элементы
+// (по строкам, нумерация узлов с нуля)
+void TMesh::set_mesh(string fetype, TView<double> px, TView<TIndex> pfe, TView<TIndex> pbe)
+{
+    int fe_size,
         be_size,
         dim;
+    auto is_valid = [](TView<TIndex> v, size_t nodes) { return all_of(v.begin(), v.end(), [nodes](TIndex i) { return i >= 0 and size_t(i) < nodes; }); };
+
+    if ((type = decode_mesh_type(fetype, be_size, fe_size, dim)) == FEType::undefined)
+        throw TError(Message::MeshFormat);
+    if (px.empty() or px.size() % size_t(dim) or pfe.empty() or pfe.size() % size_t(fe_size) or
+        not is_valid(pfe, px.size() / size_t(dim)) or not is_valid(pbe, px.size() / size_t(dim)))
+        throw TError(Message::MeshFormat);
+    set_storage(px.size() / size_t(dim));
+    x.resize(px.size() / size_t(dim), size_t(dim));
+    x.apply([&px](auto *p) { copy(px.begin(), px.end(), p); });
+    fe.resize(pfe.size() / size_t(fe_size), size_t(fe_size));
+    fe.apply([&pfe](auto *p) { copy(pfe.begin(), pfe.end(), p); });
+    fe_count = fe.size1();
+    fe_first = 0;
+    chunk_size = 0;
+    if (is_plate() or is_shell() or type == FEType::fe2d6)
+        be = fe;
+    else
+    {
+        if ((be_size and pbe.size() % size_t(be_size)) or (pbe.empty() and (type == FEType::fe2d3 or type == FEType::fe2d4 or type == FEType::fe3d4 or type == FEType::fe3d8)))
+            throw TError(Message::MeshFormat);
+        be.resize(be_size ? pbe.size() / size_t(be_size) : 0, size_t(be_size));
+        be.apply([&pbe](auto *p) { copy(pbe.begin(), pbe.end(), p); });
+    }
+    mesh_file.clear();
+    is_hash = false;
+    cout << *this << endl;
+    create_mesh_map();
+}
+
+// Типы хранения координат и номеров узлов для сетки из nodes узлов
+void TMesh::set_storage(size_t nodes)
+{
+    x.set_storage(is_compact);
+    fe.set_storage(true, TIndex(max(nodes, size_t(1)) - 1));
+    be.set_storage(true, TIndex(max(nodes, size_t(1)) - 1));
+}
+
+// Чтение сетки из файла без анализа ее структуры
+void TMesh::read(string name)
+{
     ifstream file;
+    TTraceScope trace("mesh_load");
 
     file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     try
     {
-        if (filesystem::exists(name))
-            file.open(name);
+        if ((is_binary = TMeshFile::is_mesh_file(name)))
+            read_binary(name);
         else
-            file.open(path + "/" + name);
-        file >> fetype;
-        if ((type = decode_mesh_type(fetype, be_size, fe_size, dim)) == FEType::undefined)
-            throw TError(Message::MeshFormat);
-        file >> val;
-        if (val <= 0 or dim < 1 or dim > 3)
-            throw TError(Message::MeshFormat);
-        x.resize(val, dim);
-        for (auto i = 0; i < val; i++)
-            for (auto j = 0; j < dim; j++)
-                file >> x(i, j);
-        file >> val;
-        if (val == 0)
+        {
+            file.open(name);
+            read(file);
+            file.close();
+        }
+        mesh_file = name;
+        is_hash = false;
+        trace.set_count(x.size1());
+        // Хеш запоминается сразу, чтобы последующие изменения файла можно было обнаружить (см. is_loaded)
+        get_hash();
+    }
+    catch (fstream::failure&)
+    {
+        file.close();
+        throw TError(Message::ReadFile);
+    }
+}
+
+// Чтение двоичного файла сетки (см. meshfile.h)
+void TMesh::read_binary(string name)
+{
+    TMappedFile file;
+    const TMeshHeader *header;
+    const double *px;
+    const char *pfe,
+               *pbe;
+    int fe_size,
+        be_size,
+        dim;
+
+    if (not file.open(name))
+        throw TError(Message::ReadFile);
+    if ((header = file.at<TMeshHeader>(0)) == nullptr or memcmp(header->signature, mesh_signature, sizeof(mesh_signature)) or
+        (index_size = TMeshFile::index_size(*header)) == 0)
+        throw TError(Message::MeshFormat);
+    if ((type = decode_mesh_type(string(header->fe_type, strnlen(header->fe_type, sizeof(header->fe_type))), be_size, fe_size, dim)) == FEType::undefined or
+        header->dim not_eq uint32_t(dim) or header->fe_size not_eq uint32_t(fe_size) or header->be_size not_eq uint32_t(be_size) or
+        header->nodes <= 0 or uint64_t(header->nodes) > uint64_t(numeric_limits<TIndex>::max()) or header->fe_count <= 0 or header->be_count < 0)
+        throw TError(Message::MeshFormat);
+    fe_count = size_t(header->fe_count);
+    fe_first = 0;
+    fe_offset = streamoff(header->fe_offset);
+    px = file.at<double>(header->x_offset, size_t(header->nodes) * size_t(dim));
+    pfe = file.at<char>(header->fe_offset, fe_count * size_t(fe_size) * index_size);
+    pbe = file.at<char>(header->be_offset, size_t(header->be_count) * size_t(be_size) * index_size);
+    if (not px or not pfe or not pbe)
+        throw TError(Message::MeshFormat);
+    set_storage(size_t(header->nodes));
+    x.resize(size_t(header->nodes), size_t(dim));
+    x.apply([this, px](auto *p) { copy(px, px + x.size1() * x.size2(), p); });
+    // В потоковом режиме блоки КЭ читаются и проверяются в load_fe
+    fe.resize(chunk_size ? 0 : fe_count, size_t(fe_size));
+    // Для пластин и оболочек граничными элементами являются сами КЭ (в потоковом режиме таблица хранится только здесь)
+    if (is_plate() or is_shell() or type == FEType::fe2d6)
+    {
+        be.resize(fe_count, size_t(fe_size));
+        pbe = pfe;
+    }
+    else
+        be.resize(size_t(header->be_count), size_t(be_size));
+    if (not fe.apply([this, pfe](auto *p) { return TMeshFile::convert(pfe, index_size, fe.size1() * fe.size2(), x.size1(), p); }) or
+        not be.apply([this, pbe](auto *p) { return TMeshFile::convert(pbe, index_size, be.size1() * be.size2(), x.size1(), p); }))
+        throw TError(Message::MeshFormat);
+}
+
+// Чтение сетки из потока (формат файла сетки и раздела "Mesh" файла результатов)
+void TMesh::read(istream &file)
+{
+    string fetype;
+    TIndex val;
+    double coord;
+    int fe_size,
+        be_size,
+        dim;
+    // Номер узла (с проверкой, т.к. хранится в типе, выбранном по количеству узлов)
+    auto read_index = [&file, this](void)
+    {
+        TIndex index;
+
+        file >> index;
+        if (index < 0 or size_t(index) >= x.size1())
             throw TError(Message::MeshFormat);
-        fe.resize(val, fe_size);
-        for (auto i = 0; i < val; i++)
+        return index;
+    };
+
+    file >> fetype;
+    if ((type = decode_mesh_type(fetype, be_size, fe_size, dim)) == FEType::undefined)
+        throw TError(Message::MeshFormat);
+    file >> val;
+    if (val <= 0 or dim < 1 or dim > 3)
+        throw TError(Message::MeshFormat);
+    set_storage(size_t(val));
+    x.resize(size_t(val), size_t(dim));
+    for (TIndex i = 0; i < val; i++)
+        for (auto j = 0; j < dim; j++)
+        {
+            file >> coord;
+            x.set(size_t(i), size_t(j), coord);
+        }
+    file >> val;
+    if (val <= 0)
+        throw TError(Message::MeshFormat);
+    fe_count = size_t(val);
+    fe_first = 0;
+    if (chunk_size)
+    {
+        // Таблица КЭ пропускается (читается блоками в load_fe), для пластин и оболочек она же - граничные элементы
+        bool is_be = is_plate() or is_shell() or type == FEType::fe2d6;
+        TIndex skip;
+
+        fe_offset = next_offset = file.tellg();
+        next_first = 0;
+        fe.resize(0, size_t(fe_size));
+        if (is_be)
+            be.resize(size_t(val), size_t(fe_size));
+        for (TIndex i = 0; i < val; i++)
             for (auto j = 0; j < fe_size; j++)
-                file >> fe(i, j);
-        file >> val;
-        if (val == 0 and (type == FEType::fe2d3 or type == FEType::fe2d4 or type == FEType::fe3d4 or type == FEType::fe3d8))
-            throw TError(Message::MeshFormat);
-        if ((type == FEType::fe2d3p or type == FEType::fe2d4p or type == FEType::fe2d6) or (type == FEType::fe3d3s or type == FEType::fe3d4s or type == FEType::fe3d6s))
+                if (is_be)
+                    be.set(size_t(i), size_t(j), read_index());
+                else
+                    file >> skip;
+    }
+    else
+    {
+        fe.resize(size_t(val), size_t(fe_size));
+        for (TIndex i = 0; i < val; i++)
+            for (auto j = 0; j < fe_size; j++)
+                fe.set(size_t(i), size_t(j), read_index());
+    }
+    file >> val;
+    if (val == 0 and (type == FEType::fe2d3 or type == FEType::fe2d4 or type == FEType::fe3d4 or type == FEType::fe3d8))
+        throw TError(Message::MeshFormat);
+    if ((type == FEType::fe2d3p or type == FEType::fe2d4p or type == FEType::fe2d6) or (type == FEType::fe3d3s or type == FEType::fe3d4s or type == FEType::fe3d6s))
+    {
+        if (not chunk_size)
             be = fe;
-        else // if (feDim not_eq 1)
+    }
+    else // if (feDim not_eq 1)
+    {
+        be.resize(size_t(val), size_t(be_size));
+        for (TIndex i = 0; i < val; i++)
+            for (auto j = 0; j < be_size; j++)
+                be.set(size_t(i), size_t(j), read_index());
+    }
+}
+
+// Загрузка блока КЭ, начинающегося с first (в потоковом режиме); возвращает количество КЭ,
+// доступных начиная с first
+size_t TMesh::load_fe(size_t first)
+{
+    ifstream file;
+    size_t count = min(chunk_size, fe_count - first),
+           size = fe.size2();
+    vector<char> buffer;
+    TIndex val;
+    bool is_valid = true;
+
+    if (not chunk_size)
+        return fe_count - first;
+    if (first >= fe_first and first < fe_first + fe.size1())
+        return fe_first + fe.size1() - first;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try
+    {
+        fe.resize(count, size);
+        if (is_binary)
         {
-            be.resize(val, be_size);
-            for (auto i = 0; i < val; i++)
-                for (auto j = 0; j < be_size; j++)
-                    file >> be(i, j);
+            // Индексы файла преобразуются к типу хранения таблицы (с проверкой)
+            buffer.resize(count * size * index_size);
+            file.open(mesh_file, ios::binary);
+            file.seekg(fe_offset + streamoff(first * size * index_size));
+            file.read(buffer.data(), streamsize(buffer.size()));
+        }
+        else
+        {
+            // Текстовый файл читается с конца предыдущего блока (при возврате к началу - с начала таблицы)
+            file.open(mesh_file);
+            if (first < next_first)
+            {
+                next_first = 0;
+                next_offset = fe_offset;
+            }
+            file.seekg(next_offset);
+            for (; next_first < first; next_first++)
+                for (auto j = 0u; j < size; j++)
+                    file >> val;
+            for (auto i = 0u; i < count; i++)
+                for (auto j = 0u; j < size; j++)
+                {
+                    file >> val;
+                    is_valid = is_valid and val >= 0 and size_t(val) < x.size1();
+                    fe.set(i, j, val);
+                }
+            next_offset = file.tellg();
+            next_first = first + count;
         }
-        file.close();
-        cout << *this << endl;
-        create_mesh_map();
     }
     catch (fstream::failure&)
     {
-        file.close();
+        fe.resize(0, size);
         throw TError(Message::ReadFile);
     }
+    if (is_binary)
+        is_valid = fe.apply([&](auto *p) { return TMeshFile::convert(buffer.data(), index_size, count * size, x.size1(), p); });
+    if (not is_valid)
+    {
+        fe.resize(0, size);
+        throw TError(Message::MeshFormat);
+    }
+    fe_first = first;
+    return count;
 }
 
-matrix<double> TMesh::get_coord_fe(int index)
+matrix<double> TMesh::get_coord_fe(size_t index)
 {
     matrix<double> coord(fe.size2(), 3);
 
+    // Координаты узлов приводятся к double только здесь
     for (auto i = 0u; i < fe.size2(); i++)
-        for (auto j = 0u; j < x.size2(); j++)
-            coord(i, j) = x(fe(index, i), j);
+        x.get_row(size_t(fe(index - fe_first, i)), coord[i]);
     return coord;
 }
 
-array<double, 3> TMesh::get_coord_fe(int index, int vertex)
+array<double, 3> TMesh::get_coord_fe(size_t index, size_t vertex)
 {
     array<double, 3> coord;
 
-    for (auto i = 0u; i < x.size2(); i++)
-        coord[i] = x(fe(index, vertex), i);
+    x.get_row(size_t(fe(index - fe_first, vertex)), coord.data());
     return coord;
 }
 
@@ -131,18 +357,32 @@ int TMesh::get_freedom(void)
 void TMesh::create_mesh_map(void)
 {
     TProgress progress;
+    TTraceScope trace("mesh_map", fe_count);
+    vector<TIndex> row(fe.size2());
 
-    mesh_map.resize(x.size1());
-    progress.set_process(Message::AnalysingMesh, 1, int(fe.size1()));
-    for (unsigned i = 0; i < fe.size1(); /*msg->addProgress(),*/ i++)
-        for (unsigned j = 0; j < fe.size2(); j++)
-            for (unsigned k = 0; k < fe.size2(); k++)
-                if (k not_eq j)
-                    if (find(mesh_map[fe(i, j)].begin(), mesh_map[fe(i, j)].end(), fe(i, k)) == mesh_map[fe(i, j)].end())
-                        mesh_map[fe(i, j)].push_back(fe(i, k));
-
-    for (unsigned i = 0; i < mesh_map.size(); i++)
-        sort(mesh_map[i].begin(), mesh_map[i].end(), [](unsigned k, unsigned l) -> bool{ return (k < l); });
+    // Карта строится заново (сетка могла быть заменена в той же модели)
+    mesh_map.assign(x.size1(), {});
+    progress.set_process(Message::AnalysingMesh, 1, fe_count);
+    // В потоковом режиме - первый проход по блокам таблицы КЭ (второй - ансамблирование)
+    for (size_t first = 0, count; first < fe_count; first += count)
+    {
+        count = load_fe(first);
+        for (size_t i = first - fe_first; i < fe.size1(); /*msg->addProgress(),*/ i++)
+        {
+            fe.get_row(i, row.data());
+            for (size_t j = 0; j < row.size(); j++)
+            {
+                auto &list = mesh_map[size_t(row[j])];
+
+                for (size_t k = 0; k < row.size(); k++)
+                    if (k not_eq j and find(list.begin(), list.end(), row[k]) == list.end())
+                        list.push_back(row[k]);
+            }
+        }
+    }
+
+    for (auto &it: mesh_map)
+        sort(it.begin(), it.end());
     progress.stop_process();
 }
 
@@ -161,38 +401,109 @@ ostream &operator << (ostream &out, TMesh &r)
 {
     out << say_message(Message::FEType) << r.fe_name() << endl;
     out << say_message(Message::NumNodes) << r.x.size1() << endl;
-    out << say_message(Message::NumFE) << r.fe.size1() << endl;
+    out << say_message(Message::NumFE) << r.fe_count << endl;
     return out;
 }
 
-void TMesh::write(ofstream &out)
+string TMesh::get_type_name(void)
 {
-    out << "Mesh" << endl;
-    out << get<0>(*find_if(fe_type_table.begin(), fe_type_table.end(), [this](const auto &it) { return get<1>(it) == this->type; }))  << endl;
-    out << x.size1() << endl;
-    for (auto i = 0u; i < x.size1(); i++)
+    return get<0>(*find_if(fe_type_table.begin(), fe_type_table.end(), [this](const auto &it) { return get<1>(it) == this->type; }));
+}
+
+void TMesh::write(TResultFile &out)
+{
+    TIndexTable empty;
+
+    out.write_mesh(get_type_name(), x, fe, (is_plate() or is_shell()) ? empty : be);
+}
+
+// Хеш содержимого файла сетки (вычисляется один раз)
+uint64_t TMesh::get_hash(void)
+{
+    THash hash;
+
+    if (not is_hash)
     {
-        for (auto j = 0u; j < x.size2(); j++)
-            out << x(i, j) << ' ';
-        out << endl;
+        if (not hash.add_file(mesh_file))
+            throw TError(Message::ReadFile);
+        mesh_hash = hash.value();
+        is_hash = true;
     }
-    out << fe.size1() << endl;
-    for (auto i = 0u; i < fe.size1(); i++)
+    return mesh_hash;
+}
+
+// Проверка, что сетка уже прочитана из того же (не изменившегося) файла
+bool TMesh::is_loaded(string path, string name)
+{
+    THash hash;
+    string file = filesystem::exists(name) ? name : path + "/" + name;
+
+    return mesh_file.length() and file == mesh_file and hash.add_file(file) and hash.value() == get_hash();
+}
+
+// Объем памяти, занимаемой сеткой и ее картой связей (байт)
+size_t TMesh::get_memory_size(void)
+{
+    size_t size = x.memory_size() + fe.memory_size() + be.memory_size();
+
+    for (auto &it: mesh_map)
+        size += it.capacity() * sizeof(TIndex) + sizeof(it);
+    return size;
+}
+
+// Путь к файлу сетки относительно каталога dir (абсолютный, если относительный не определен)
+string TMesh::get_ref_path(string dir)
+{
+    error_code ec;
+    filesystem::path file = filesystem::absolute(mesh_file, ec),
+                     ret = filesystem::relative(file, filesystem::absolute(dir.length() ? dir : ".", ec), ec);
+
+    return (ec or ret.empty()) ? file.string() : ret.string();
+}
+
+// Сетка, заданная массивами в памяти (set_mesh), не имеет файла, и вместо ссылки записывается сама сетка
+void TMesh::write_ref(ofstream &out, string dir)
+{
+    if (mesh_file.empty())
     {
-        for (auto j = 0u; j < fe.size2(); j++)
-            out << fe(i, j) << ' ';
-        out << endl;
+        write(out);
+        return;
+    }
+    out << "MeshRef" << '\n';
+    out << get_type_name() << '\n';
+    out << get_ref_path(dir) << '\n';
+    out << THash::str(get_hash()) << '\n';
+}
+
+void TMesh::write_ref(TResultFile &out, string dir)
+{
+    TIndexTable empty;
+
+    if (mesh_file.empty())
+    {
+        write(out);
+        return;
+    }
+    out.write_mesh_ref(get_type_name(), get_ref_path(dir), get_hash(), x, fe, (is_plate() or is_shell()) ? empty : be, fe_count);
+}
+
+void TMesh::write(ofstream &out)
+{
+    out << "Mesh" << '\n';
+    out << get_type_name() << '\n';
+    out << x.size1() << '\n';
+    x.for_rows<double>(0, x.size1(), [&](const double *p, size_t n) { TTextTable::write(out, p, n, x.size2(), " "); });
+    out << fe_count << '\n';
+    for (size_t first = 0, count; first < fe_count; first += count)
+    {
+        count = load_fe(first);
+        fe.for_rows<TIndex>(first - fe_first, count, [&](const TIndex *p, size_t n) { TTextTable::write(out, p, n, fe.size2(), " "); });
     }
     if (is_plate() or is_shell())
-        out << 0 << endl;
+        out << 0 << '\n';
     else
     {
-        out << be.size1() << endl;
-        for (unsigned i = 0; i < be.size1(); i++)
-        {
-            for (unsigned j = 0; j < be.size2(); j++)
-                out << be(i, j) << ' ';
-            out << endl;
-        }
+        out << be.size1() << '\n';
+        be.for_rows<TIndex>(0, be.size1(), [&](const TIndex *p, size_t n) { TTextTable::write(out, p, n, be.size2(), " "); });
     }
 }
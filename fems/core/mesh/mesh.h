@@ -2,14 +2,21 @@
 #define TMESH_H
 
 #include "matrix/matrix.h"
+#include "matrix/index.h"
+#include "matrix/packed.h"
+#include "matrix/view.h"
 #include "msg/msg.h"
 
+class TResultFile;
+
 // Типы конечных элементов
 enum class FEType { undefined  = 0, fe1d2, fe2d3, fe2d4, fe2d6, fe2d3p, fe2d4p, fe2d6p, fe3d4, fe3d8, fe3d10, fe3d3s, fe3d4s, fe3d6s };
 
 
 class TMesh
 {
+    // Доступ к построению карты связей для микробенчмарков (bench/bench.cpp)
+    friend class TBench;
 private:
     vector<tuple<string, FEType, int, int, int>> fe_type_table {
         { "fe1d2", FEType::fe1d2, 1, 2, 1 },
@@ -27,12 +34,33 @@ private:
         { "fe3d6s", FEType::fe3d6s, 0, 6, 3 },
     };
     FEType type = FEType::undefined;
-    vector<vector<int>> mesh_map;
-    matrix<double> x;
-    matrix<int> fe;
-    matrix<int> be;
+    vector<vector<TIndex>> mesh_map;
+    // Координаты узлов (при is_compact - в float) и таблицы номеров узлов (в наиболее узком целом типе,
+    // выбираемом по количеству узлов), см. TPackedMatrix
+    TCoordTable x;
+    TIndexTable fe;
+    TIndexTable be;
+    bool is_compact = false;
+    // Файл, из которого прочитана сетка, и хеш его содержимого
+    string mesh_file;
+    uint64_t mesh_hash = 0;
+    bool is_hash = false;
+    // Потоковый режим (chunk_size > 0): таблица КЭ целиком не хранится, fe содержит только блок
+    // из не более чем chunk_size КЭ, начинающийся с КЭ fe_first (см. load_fe)
+    size_t chunk_size = 0;
+    size_t fe_count = 0;
+    size_t fe_first = 0;
+    // Положение таблицы КЭ в файле сетки и конца последнего прочитанного блока (текстовый файл читается последовательно),
+    // размер индекса в двоичном файле
+    bool is_binary = false;
+    unsigned index_size = sizeof(TIndex);
+    streamoff fe_offset = 0;
+    streamoff next_offset = 0;
+    size_t next_first = 0;
     FEType decode_mesh_type(string, int&, int&, int&);
     void create_mesh_map(void);
+    void set_storage(size_t);
+    void read_binary(string);
     string fe_name(void);
 public:
     TMesh(void) noexcept {}
@@ -41,39 +69,85 @@ public:
     {
         return type;
     }
-    matrix<double> &get_x(void) noexcept
+    TCoordTable &get_x(void) noexcept
     {
         return x;
     }
-    matrix<int> &get_fe(void) noexcept
+    TIndexTable &get_fe(void) noexcept
     {
         return fe;
     }
-    matrix<int> &get_be(void) noexcept
+    TIndexTable &get_be(void) noexcept
     {
         return be;
     }
-    double get_x(int i, int j) const noexcept
+    double get_x(size_t i, size_t j) const noexcept
     {
         return x(i, j);
     }
-    int get_fe(int i, int j) const noexcept
+    TIndex get_fe(size_t i, size_t j) const noexcept
     {
-        return fe(i, j);
+        return fe(i - fe_first, j);
     }
-    int get_be(int i, int j) const noexcept
+    TIndex get_be(size_t i, size_t j) const noexcept
     {
         return be(i, j);
     }
     int get_freedom(void);
-    vector<int>& get_mesh_map(int i)
+    // Общее количество КЭ (в потоковом режиме get_fe() содержит только текущий блок)
+    size_t get_fe_count(void) const noexcept
+    {
+        return fe_count;
+    }
+    // Потоковое чтение таблицы КЭ блоками по chunk элементов (0 - сетка хранится целиком);
+    // задается до чтения сетки из файла
+    void set_stream(size_t chunk) noexcept
+    {
+        chunk_size = TMesh::chunk(chunk);
+    }
+    // Размер блока содержит целое число пакетов TShapeBatch
+    static size_t chunk(size_t size) noexcept
+    {
+        return (size + 63) / 64 * 64;
+    }
+    size_t get_stream(void) const noexcept
+    {
+        return chunk_size;
+    }
+    bool is_stream(void) const noexcept
+    {
+        return chunk_size > 0;
+    }
+    // Хранение координат узлов в float (координаты преобразуются к double только при выборке
+    // координат КЭ, см. get_coord_fe); задается до чтения сетки
+    void set_compact(bool compact) noexcept
+    {
+        is_compact = compact;
+    }
+    bool get_compact(void) const noexcept
+    {
+        return is_compact;
+    }
+    size_t load_fe(size_t);
+    vector<TIndex>& get_mesh_map(size_t i)
     {
         return mesh_map[i];
     }
     void set_mesh_file(string, string);
-    matrix<double> get_coord_fe(int);
-    array<double, 3> get_coord_fe(int, int);
-    template <class T> vector<T> get_shape(int i)
+    void set_mesh(string, TView<double>, TView<TIndex>, TView<TIndex> = {});
+    void read(string);
+    void read(istream&);
+    string get_mesh_file(void) const noexcept
+    {
+        return mesh_file;
+    }
+    uint64_t get_hash(void);
+    bool is_loaded(string, string);
+    size_t get_memory_size(void);
+    string get_ref_path(string);
+    matrix<double> get_coord_fe(size_t);
+    array<double, 3> get_coord_fe(size_t, size_t);
+    template <class T> vector<T> get_shape(size_t i)
     {
         matrix<double> px = get_coord_fe(i),
                        m(T::size(), T::size() + 1);
@@ -96,6 +170,11 @@ public:
     }
     friend ostream &operator << (ostream&, TMesh&);
     void write(ofstream&);
+    void write(TResultFile&);
+    // Запись ссылки на файл сетки вместо самой сетки
+    void write_ref(ofstream&, string);
+    void write_ref(TResultFile&, string);
+    string get_type_name(void);
     bool is_1d(void)
     {
         return type == FEType::fe1d2 ? true : false;
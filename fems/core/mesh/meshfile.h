@@ -0,0 +1,114 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <limits>
+#include "matrix/index.h"
+
+using namespace std;
+
+/***************************************************/
+/*          Двоичный файл сетки (.bmsh)            */
+/*  заголовок | координаты | КЭ | граничные эл-ты  */
+/***************************************************/
+constexpr char mesh_signature[8] = "FEMSMSH";
+constexpr uint32_t mesh_version = 2;
+
+struct TMeshHeader
+{
+    char signature[8];          // "FEMSMSH"
+    uint32_t version;
+    uint32_t dim;               // Размерность координат
+    char fe_type[16];           // Тип КЭ ("fe3d4" и т.п.)
+    uint32_t fe_size;           // Количество узлов КЭ
+    uint32_t be_size;           // Количество узлов граничного элемента
+    int64_t nodes;
+    int64_t fe_count;
+    int64_t be_count;
+    uint64_t x_offset;          // Координаты (double, nodes * dim)
+    uint64_t fe_offset;         // Связность КЭ (index_size байт на индекс, fe_count * fe_size, нумерация узлов с нуля)
+    uint64_t be_offset;         // Граничные элементы (be_count * be_size)
+    uint32_t index_size;        // Размер индекса: 4 или 8 байт (в версии 1 поля нет, индексы - int32)
+    uint32_t reserved;
+};
+
+class TMeshFile
+{
+private:
+    static uint64_t write_block(ofstream &out, const void *data, uint64_t size)
+    {
+        char pad[8] = { 0 };
+        uint64_t pos = uint64_t(out.tellp()),
+                 offset = (pos + 7) & ~uint64_t(7);
+
+        out.write(pad, streamsize(offset - pos));
+        out.write(static_cast<const char*>(data), streamsize(size));
+        return offset;
+    }
+public:
+    // Запись сетки (индексы - в разрядности TIndex); ошибки - исключение fstream::failure
+    static void write(const string &name, const string &fe_type, const double *x, size_t nodes, unsigned dim,
+                      const TIndex *fe, size_t fe_count, unsigned fe_size, const TIndex *be, size_t be_count, unsigned be_size)
+    {
+        ofstream out;
+        TMeshHeader header;
+
+        out.exceptions(ofstream::failbit | ofstream::badbit);
+        out.open(name, ios::binary);
+        memset(&header, 0, sizeof(header));
+        memcpy(header.signature, mesh_signature, sizeof(header.signature));
+        strncpy(header.fe_type, fe_type.c_str(), sizeof(header.fe_type) - 1);
+        header.version = mesh_version;
+        header.index_size = sizeof(TIndex);
+        header.dim = dim;
+        header.fe_size = fe_size;
+        header.be_size = be_size;
+        header.nodes = int64_t(nodes);
+        header.fe_count = int64_t(fe_count);
+        header.be_count = int64_t(be_count);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        header.x_offset = write_block(out, x, nodes * dim * sizeof(double));
+        header.fe_offset = write_block(out, fe, fe_count * fe_size * sizeof(TIndex));
+        header.be_offset = write_block(out, be, be_count * be_size * sizeof(TIndex));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+    }
+    // Размер индекса в файле (0 - неизвестная версия формата)
+    static unsigned index_size(const TMeshHeader &header) noexcept
+    {
+        if (header.version == 1)
+            return sizeof(int32_t);
+        return header.version == mesh_version and (header.index_size == sizeof(int32_t) or header.index_size == sizeof(int64_t)) ? header.index_size : 0;
+    }
+    // Преобразование count индексов размером size байт в тип I (TIndex или более узкий тип, вмещающий
+    // номера узлов, см. TMesh::set_storage); false - индекс вне [0, nodes)
+    template <typename I> static bool convert(const void *src, unsigned size, size_t count, size_t nodes, I *dst) noexcept
+    {
+        auto copy = [&](auto *p)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (p[i] < 0 or uint64_t(p[i]) >= nodes or uint64_t(p[i]) > uint64_t(numeric_limits<TIndex>::max()))
+                    return false;
+                dst[i] = I(p[i]);
+            }
+            return true;
+        };
+
+        return size == sizeof(int64_t) ? copy(static_cast<const int64_t*>(src)) : copy(static_cast<const int32_t*>(src));
+    }
+    // Проверка сигнатуры двоичного файла сетки
+    static bool is_mesh_file(const string &name)
+    {
+        ifstream in(name, ios::binary);
+        char signature[sizeof(mesh_signature)] = { 0 };
+
+        return in.read(signature, sizeof(signature)) and memcmp(signature, mesh_signature, sizeof(signature)) == 0;
+    }
+};
+
+#endif // MESHFILE_H
@@ -4,6 +4,7 @@
 #include <string>
 #include <sstream>
 #include <thread>
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <iomanip>
@@ -11,10 +12,12 @@
 enum class Message { Undefined = 0, NotSpecifiedProgram, UndefinedVariable, EmptyProgram, Syntax, Bracket, InvalidIdentifier, VariableOverride, AssignmentArgument,
                      AssignmentResult, UsingArgument, InvalidInitialisation, InvalidOperation, MeshFormat, InvalidFE, ReadFile, InternalError, AsScalar,
                      AsVector, AsMatrix, IncorrectFE, NotSolution, InvalidBoundaryCondition, Preprocessor, NotMesh,
+                     UnknownDirective, OutputFormat, MeshChanged, Socket, SweepFormat, MatrixFormat, MemoryFormat, StreamFormat,
 
                      GeneratingMatrix, UsingBoundaryCondition, PreparingSystemEquation, FactorizationSystemEquation, SolutionSystemEquation, AnalysingMesh, WritingResult,
                      GeneratingResult, Timer, Sec, FEType, FE1D2, FE2D3, FE2D4, FE2D6, FE3D4, FE3D8, FE3D10, FE2D3P, FE2D4P, FE2D6P, FE3D3S, FE3D4S, FE3D6S, NumNodes,
-                     NumFE };
+                     NumFE, ReadingCache, WritingCache, CalculatingVariants, RefinementResidual, RefinementIterations, FactorSize, OutOfCore,
+                     RefinementFailed, SkippedParameter };
 
 
 using namespace std;
@@ -44,7 +47,21 @@ inline string say_message(Message msg)
                                               { Message::FE3D3S, "shell triangular element (3 nodes)" }, { Message::FE3D4S, "shell quadrilateral element (4 nodes)" },
                                               { Message::FE3D6S, "shell triangular element (6 nodes)" }, { Message::NumNodes, "Number of nodes - " },
                                               { Message::NumFE, "Number of finite elements - " }, { Message::WritingResult, "Writing results" },
-                                              { Message::GeneratingResult, "Calculation of results" } };
+                                              { Message::GeneratingResult, "Calculation of results" }, { Message::UnknownDirective, "Unknown preprocessor directive" },
+                                              { Message::OutputFormat, "Unknown output format" }, { Message::MeshChanged, "Referenced mesh file has been changed" },
+                                              { Message::Socket, "Socket error" }, { Message::SweepFormat, "Incorrect parameter sweep" },
+                                              { Message::MatrixFormat, "Unknown matrix storage format" },
+                                              { Message::MemoryFormat, "Incorrect memory budget" },
+                                              { Message::StreamFormat, "Incorrect size of the element block" },
+                                              { Message::ReadingCache, "Reading the cached system of equations" },
+                                              { Message::WritingCache, "Caching the system of equations" },
+                                              { Message::CalculatingVariants, "Calculation of parameter variants" },
+                                              { Message::RefinementResidual, "Relative residual after iterative refinement - " },
+                                              { Message::RefinementIterations, ", iterations - " },
+                                              { Message::FactorSize, "Factorization size (MB) - " },
+                                              { Message::OutOfCore, ", out-of-core (factor is stored on disk)" },
+                                              { Message::RefinementFailed, ", the required accuracy is not reached - refactorizing in double precision" },
+                                              { Message::SkippedParameter, "Parameter is not used by the program and is skipped - " } };
 
     return find_if(msg_table.begin(), msg_table.end(), [msg](pair<Message, string> i) { return i.first == msg; } )->second;
 }
@@ -61,6 +78,10 @@ public:
     {
         return say_message(msg);
     }
+    inline Message get_message(void) const noexcept
+    {
+        return msg;
+    }
 };
 
 
@@ -69,6 +90,10 @@ class TProgress
 private:
     chrono::system_clock::time_point timer;
     bool is_stopped = false;
+    // Индикатор запущен в отдельном потоке (set_process без диапазона)
+    bool is_thread = false;
+    // Режим без вывода на экран (индикаторы и их потоки не создаются)
+    static inline atomic<bool> is_quiet{false};
     thread progress_thread;
     void backgroundRun(bool& isStopped)
     {
@@ -85,9 +110,9 @@ private:
     }
 protected:
     Message process_code;
-    int process_start;
-    int process_stop;
-    int process_current;
+    size_t process_start;
+    size_t process_stop;
+    size_t process_current;
     int process_step;
     int old_persent;
 public:
@@ -98,31 +123,44 @@ public:
         process_step = 1;
     }
     virtual ~TProgress(void) {}
+    static void set_quiet(bool quiet) noexcept
+    {
+        is_quiet = quiet;
+    }
+    static bool get_quiet(void) noexcept
+    {
+        return is_quiet;
+    }
     virtual void set_process(Message code)
     {
         is_stopped = false;
         process_code = code;
         process_start = process_stop = process_current = old_persent = 0;
-
+        timer = chrono::system_clock::now();
+        if (is_quiet)
+            return;
+        is_thread = true;
         progress_thread = thread(&TProgress::backgroundRun, this, ref(this->is_stopped));
         progress_thread.detach();
-        timer = chrono::system_clock::now();
     }
-    virtual void set_process(Message code, int start, int stop, int step = 1)
+    virtual void set_process(Message code, size_t start, size_t stop, int step = 1)
     {
         process_code = code;
         process_start = start;
         process_stop = stop;
         process_step = step;
         process_current = old_persent = 0;
-        cout << '\r' << say_message(process_code) << "... 0%" << flush;
         timer = chrono::system_clock::now();
+        if (not is_quiet)
+            cout << '\r' << say_message(process_code) << "... 0%" << flush;
     }
     virtual void add_progress(void)
     {
         stringstream ss;
-        int persent = (process_stop - process_start) ? int((100.0 * double(++process_current)) / double(process_stop - process_start)) : 100;
+        int persent = (process_stop > process_start) ? int((100.0 * double(++process_current)) / double(process_stop - process_start)) : 100;
 
+        if (is_quiet)
+            return;
         if (process_current == process_stop)
         {
             ss << '\r' << say_message(process_code) << "... 100%";
@@ -142,12 +180,17 @@ public:
     {
         stringstream ss;
 
+        if (is_quiet)
+            return;
         ss << '\r' << say_message(process_code) << "... 100%" << endl << say_message(Message::Timer) << setprecision(2) << double(static_cast<chrono::duration<double>>(chrono::system_clock::now() - timer).count()) << say_message(Message::Sec) << endl;
         cout << ss.str() << flush;
     }
     virtual void stop(void)
     {
         is_stopped = true;
+        if (not is_thread)
+            return;
+        is_thread = false;
         this_thread::sleep_for(std::chrono::milliseconds(200));
         cout << say_message(Message::Timer) << setprecision(3) << double((static_cast< chrono::duration<double> >(chrono::system_clock::now() - timer).count())) << say_message(Message::Sec) << endl;
     }
@@ -10,7 +10,19 @@ using namespace std;
 using namespace Parser;
 
 
-template <class T> array<double, 3> TValue<T>::x{0, 0, 0};
+//-----------------------------------------------------------------------
+// Контекст вычисления выражений: текущая точка и координаты текущего КЭ
+// (у каждого анализатора свой, поэтому анализаторы могут работать параллельно)
+//-----------------------------------------------------------------------
+struct TContext
+{
+    array<double, 3> x{ 0, 0, 0 };
+    matrix<double> fe_coord;
+    // Якобианы в точках интегрирования (заранее вычисленные при пакетной обработке КЭ)
+    vector<double> fe_jacobian;
+    // Сравнение в одинарной точности (условия на координаты узлов, хранящиеся в float, см. TMesh::set_compact)
+    bool is_single = false;
+};
 
 template <class T> class TNode
 {
@@ -19,7 +31,38 @@ private:
     variant<TValue<T>, TValue<T>*> val;
     shared_ptr<TNode> left;
     shared_ptr<TNode> right;
-    static matrix<double> fe_coord;
+    // Значение операнда в текущей точке
+    TValue<T> point_value(const shared_ptr<TNode> &node, TContext &ctx) const
+    {
+        return node->value(ctx).value(ctx.x);
+    }
+    // Сравнение операндов (при ctx.is_single - округленных до float)
+    int compare(TContext &ctx) const
+    {
+        double lhs = left->value(ctx).asScalar(),
+               rhs = right->value(ctx).asScalar();
+
+        if (ctx.is_single)
+        {
+            lhs = double(float(lhs));
+            rhs = double(float(rhs));
+        }
+        switch (tok)
+        {
+        case Token::Eq:
+            return lhs == rhs;
+        case Token::Ne:
+            return lhs not_eq rhs;
+        case Token::Lt:
+            return lhs < rhs;
+        case Token::Le:
+            return lhs <= rhs;
+        case Token::Gt:
+            return lhs > rhs;
+        default:
+            return lhs >= rhs;
+        }
+    }
 public:
     TNode(void) {}
     TNode(TValue<T> v) : tok{Token::Number}, val{v} {}
@@ -28,7 +71,7 @@ public:
     TNode(shared_ptr<TNode> lhs,  Token t, shared_ptr<TNode> rhs) : tok{t}, left{make_shared<TNode>(*lhs)}, right{make_shared<TNode>(*rhs)} {}
     TNode(const TNode &rhs) : tok{rhs.tok}, val{rhs.val}, left{rhs.left}, right{rhs.right} {}
     ~TNode(void) noexcept {}
-    TValue<T> value(void) const
+    TValue<T> value(TContext &ctx) const
     {
         switch (tok)
         {
@@ -37,65 +80,60 @@ public:
         case Token::Variable:
             return *get<1>(val);
         case Token::Plus: // unary or binary
-            return (left == nullptr) ? right->value() : left->value() + right->value();
+            return (left == nullptr) ? right->value(ctx) : point_value(left, ctx) + point_value(right, ctx);
         case Token::Minus: // unary or binary
-            return (left == nullptr) ? -(right->value()) : left->value() - right->value();
+            return (left == nullptr) ? -(right->value(ctx)) : point_value(left, ctx) - point_value(right, ctx);
         case Token::Mul:
-            return left->value() * right->value();
+            return point_value(left, ctx) * point_value(right, ctx);
         case Token::Div:
-            return left->value() / right->value();
+            return point_value(left, ctx) / point_value(right, ctx);
         case Token::Pow:
-            return pow(left->value().asScalar(), right->value().asScalar());
+            return pow(left->value(ctx).asScalar(), right->value(ctx).asScalar());
         case Token::Eq:
-            return (left->value().asScalar() == right->value().asScalar()) ? 1 : 0;
         case Token::Ne:
-            return (left->value().asScalar() == right->value().asScalar()) ? 0 : 1;
         case Token::Lt:
-            return (left->value().asScalar() < right->value().asScalar()) ? 1 : 0;
         case Token::Le:
-            return (left->value().asScalar() <= right->value().asScalar()) ? 1 : 0;
         case Token::Gt:
-            return (left->value().asScalar() > right->value().asScalar()) ? 1 : 0;
         case Token::Ge:
-            return (left->value().asScalar() >= right->value().asScalar()) ? 1 : 0;
+            return compare(ctx);
         case Token::And:
-            return left->value().asScalar() and right->value().asScalar();
+            return left->value(ctx).asScalar() and right->value(ctx).asScalar();
         case Token::Or:
-            return left->value().asScalar() or right->value().asScalar();
+            return left->value(ctx).asScalar() or right->value(ctx).asScalar();
         case Token::Not:
-            return not right->value().asScalar();
+            return not right->value(ctx).asScalar();
         case Token::Abs:
-            return fabs(right->value().asScalar());
+            return fabs(right->value(ctx).asScalar());
         case Token::Sin:
-            return sin(right->value().asScalar());
+            return sin(right->value(ctx).asScalar());
         case Token::Cos:
-            return cos(right->value().asScalar());
+            return cos(right->value(ctx).asScalar());
         case Token::Tan:
-            return tan(right->value().asScalar());
+            return tan(right->value(ctx).asScalar());
         case Token::Exp:
-            return exp(right->value().asScalar());
+            return exp(right->value(ctx).asScalar());
         case Token::Asin:
-            return asin(right->value().asScalar());
+            return asin(right->value(ctx).asScalar());
         case Token::Acos:
-            return acos(right->value().asScalar());
+            return acos(right->value(ctx).asScalar());
         case Token::Atan:
-            return atan(right->value().asScalar());
+            return atan(right->value(ctx).asScalar());
         case Token::Sinh:
-            return sinh(right->value().asScalar());
+            return sinh(right->value(ctx).asScalar());
         case Token::Cosh:
-            return cosh(right->value().asScalar());
+            return cosh(right->value(ctx).asScalar());
         case Token::Tanh:
-            return tanh(right->value().asScalar());
+            return tanh(right->value(ctx).asScalar());
         case Token::Sqrt:
-            return sqrt(right->value().asScalar());
+            return sqrt(right->value(ctx).asScalar());
         case Token::Atan2:
-            return atan2(left->value().asScalar(), right->value().asScalar());
+            return atan2(left->value(ctx).asScalar(), right->value(ctx).asScalar());
         case Token::Variation:
-            return var(left->value(), right->value());
+            return var(point_value(left, ctx), point_value(right, ctx));
         case Token::Diff:
-            return diff(left->value(), right->value());
+            return diff(left->value(ctx), right->value(ctx));
         case Token::Integral:
-            return integral(right);
+            return integral(right, ctx);
         default:
             break;
         }
@@ -109,23 +147,19 @@ public:
         right = rhs.right;
         return *this;
     }
-    void set_fe(const matrix<double> &fec)
-    {
-        fe_coord = fec;
-    }
-    TValue<T> integral(const shared_ptr<TNode> code) const
+    TValue<T> integral(const shared_ptr<TNode> code, TContext &ctx) const
     {
         double jacobian;
         matrix<double> res(T::size() * T::freedom(), T::size() * T::freedom() + 1);
 
         for (auto i = 0; i < T::quadrature_degree(); i++)
         {
-            // Якобиан
-            jacobian = det( T::jacobi(i, fe_coord));
+            // Якобиан (заранее вычисленный при пакетной обработке КЭ)
+            jacobian = ctx.fe_jacobian.size() ? ctx.fe_jacobian[i] : det( T::jacobi(i, ctx.fe_coord));
             // Интегрирование по заданным узлам
-//            TValue<T>::x = T::x(i, inverted_jacobi);
-            TValue<T>::x = T::x(i, fe_coord);
-            res += code->value().asMatrix() * T::w(i) * abs(jacobian);
+//            ctx.x = T::x(i, inverted_jacobi);
+            ctx.x = T::x(i, ctx.fe_coord);
+            res += code->value(ctx).asMatrix() * T::w(i) * abs(jacobian);
         }
         return TValue<T>(res);
     }
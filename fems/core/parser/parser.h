@@ -17,8 +17,6 @@
 using namespace std;
 using namespace Parser;
 
-template <class T> matrix<double> TNode<T>::fe_coord{};
-
 template <class T> class TParser
 {
 private:
@@ -31,6 +29,8 @@ private:
     vector<pair<string, TNode<T>>> functional;              // Таблица функционалов
     list<tuple<string, int, TNode<T>, TNode<T>>> bc_list;   // Список граничных условий
     list<string> program;
+    list<pair<string, double>> parameter;                   // Значения констант и нагрузок, заменяющие заданные в программе
+    TContext context;                                       // Контекст вычисления выражений
     string token;
     char* expression = nullptr;
     Parser::Token tok = Token::Indefined;
@@ -129,6 +129,13 @@ private:
             set_error(Message::InternalError);
         return int(ptr - table.begin());
     }
+    // Значение константы или нагрузки name; заданное параметром варианта расчета заменяет выражение из программы
+    void set_parameter(vector<pair<string, TNode<T>>> &table, string name, const TNode<T> &value)
+    {
+        auto ptr = find_if(parameter.begin(), parameter.end(), [name](pair<string, double> i) { return i.first == name; });
+
+        set_value(table, name, ptr == parameter.end() ? value : TNode<T>(TValue<T>(ptr->second)));
+    }
     void set_error(Message error)
     {
         throw TError(error);
@@ -161,6 +168,14 @@ public:
             throw TError(Message::EmptyProgram);
         program = prog;
         compile();
+        for (auto &[name, value]: parameter)
+            if (not is_find(constant, name) and not is_find(load, name))
+                set_error(Message::UndefinedVariable);
+    }
+    // Параметры варианта расчета (задаются до set_program)
+    void set_parameters(const list<pair<string, double>> &p)
+    {
+        parameter = p;
     }
     void set_data(const vector<T> &v, const vector<double> &f = {} ) noexcept
     {
@@ -176,12 +191,19 @@ public:
             result[i].second = fun;
         }
     }
-    TValue<T> run(const matrix<double>& fe)
+    TValue<T> run(const matrix<double>& fe, const vector<double> &jacobian = {})
+    {
+        context.fe_coord = fe;
+        context.fe_jacobian = jacobian;
+        return functional.begin()->second.value(context);
+    }
+    // Значение i-й функции в точке x
+    vector<double> get_function(unsigned i, const array<double, 3> &x)
     {
-        functional.begin()->second.set_fe(fe);
-        return functional.begin()->second.value();
+        context.x = x;
+        return function[i].second.value(context).asVector(context.x);
     }
-    void get_boundary_conditions(TMesh&, list<tuple<int, int, int, double>>&);
+    void get_boundary_conditions(TMesh&, list<tuple<TIndex, int, int, double>>&);
     auto &get_result_table(void) const
     {
         return result;
@@ -190,6 +212,14 @@ public:
     {
         return function;
     }
+    auto &get_load_table(void) const
+    {
+        return load;
+    }
+    auto &get_constant_table(void) const
+    {
+        return constant;
+    }
 };
 
 template <class T> void TParser<T>::compile(void)
@@ -244,12 +274,14 @@ template <class T> void TParser<T>::get_variable(Token cur_tok)
         break;
     case Token::Constant:
         constant.push_back(pair<string, TNode<T>>(name, TNode<T>()));
+        set_parameter(constant, name, TNode<T>());
         break;
     case Token::Result:
         result.push_back(pair<string, TValue<T>>(name, TValue<T>()));
         break;
     case Token::Load:
         load.push_back(pair<string, TValue<T>>(name, TValue<T>()));
+        set_parameter(load, name, TNode<T>());
         break;
     case Token::Function:
         function.push_back(pair<string, TNode<T>>(name, TNode<T>()));
@@ -271,13 +303,13 @@ template <class T> void TParser<T>::get_variable(Token cur_tok)
         {
             if (type not_eq ValueType::Scalar)
                 set_error(Message::InvalidOperation);
-            set_value(constant, name, exp);
+            set_parameter(constant, name, exp);
         }
         else if (cur_tok == Token::Load)
         {
             if (type not_eq ValueType::Scalar)
                 set_error(Message::InvalidOperation);
-            set_value(load, name, exp);
+            set_parameter(load, name, exp);
         }
         else if (cur_tok == Token::Function)
         {
@@ -347,13 +379,13 @@ template <class T> void TParser<T>::assignment(void)
     {
         if (type not_eq ValueType::Scalar)
             set_error(Message::InvalidOperation);
-        set_value(constant, name, val);
+        set_parameter(constant, name, val);
     }
     else if (is_find(load, name))
     {
         if (type not_eq ValueType::Scalar)
             set_error(Message::InvalidOperation);
-        set_value(load, name, val);
+        set_parameter(load, name, val);
     }
     else if (is_find(function, name))
     {
@@ -745,16 +777,25 @@ template <class T> ValueType TParser<T>::token_func(TNode<T> &code)
     return ret;
 }
 
-template <class T> void TParser<T>::get_boundary_conditions(TMesh &mesh, list<tuple<int, int, int, double>> &bc)
+// Для компактной сетки (координаты в float) условия проверяются в одинарной точности:
+// иначе, например, условие x == 0.1 не выполнялось бы для узла с координатой float(0.1)
+template <class T> void TParser<T>::get_boundary_conditions(TMesh &mesh, list<tuple<TIndex, int, int, double>> &bc)
 {
-    for (auto i = 0u; i < mesh.get_x().size1(); i++)
+    context.is_single = mesh.get_compact();
+    for (size_t i = 0; i < mesh.get_x().size1(); i++)
     {
         for (auto j = 0u; j < mesh.get_x().size2(); j++)
             argument[j].second = mesh.get_x(i, j);
         for (auto [name, type, predicate, val]: bc_list)
-            if (predicate.value().asScalar() not_eq 0)
-                bc.push_back(make_tuple(i, type, (type == 1) ? get_name_no(result, name) : get_name_no(load, name), val.value().asScalar()));
+            if (predicate.value(context).asScalar() not_eq 0)
+            {
+                // Значение условия вычисляется в обычной точности
+                context.is_single = false;
+                bc.push_back(make_tuple(TIndex(i), type, (type == 1) ? get_name_no(result, name) : get_name_no(load, name), val.value(context).asScalar()));
+                context.is_single = mesh.get_compact();
+            }
     }
+    context.is_single = false;
 }
 
 
@@ -0,0 +1,273 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <list>
+#include <deque>
+#include <tuple>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#ifndef _WIN32
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <sys/un.h>
+#endif
+#include "fem/fem.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Резидентный режим: задания принимаются через локальный сокет (UNIX domain)
+// и выполняются пулом потоков. Модели (сетка с картой связей, структура матрицы
+// и ее разложение) после расчета остаются в кэше LRU с ограничением объема памяти
+// и используются повторно для заданий с той же сеткой.
+//
+// Запрос:  "<text|binary> <файл программы .prg>\n"
+// Ответ:   "OK <размер>\n" и содержимое файла результатов (.res или .bres)
+//          либо "ERROR <сообщение>\n"
+//
+// Результаты задания записываются во временный файл рядом с программой (одновременные задания
+// с одной программой не мешают друг другу) и удаляются после передачи
+//-----------------------------------------------------------------------
+template <class S> class TService
+{
+private:
+    string name;
+    unsigned workers;
+    // Ограничение объема кэша моделей (байт)
+    size_t capacity;
+    // Время ожидания запроса и передачи ответа (секунд): клиент, не приславший запрос, не занимает поток
+    static constexpr int timeout = 60;
+    // Номер задания для имен временных файлов результатов
+    atomic<unsigned long long> job{0};
+    int listener = -1;
+    mutex mtx;
+    condition_variable cv;
+    deque<int> jobs;
+    bool is_stopped = false;
+    // Кэш моделей в порядке последнего использования: файл сетки, модель, ее объем
+    list<tuple<string, unique_ptr<TFEM<S>>, size_t>> cache;
+    size_t cached = 0;
+    // Модель для сетки key из кэша (или новая); модель изымается из кэша на время расчета
+    unique_ptr<TFEM<S>> take(const string &key)
+    {
+        lock_guard<mutex> lock(mtx);
+        unique_ptr<TFEM<S>> fem;
+
+        for (auto it = cache.begin(); it not_eq cache.end(); ++it)
+            if (get<0>(*it) == key)
+            {
+                fem = move(get<1>(*it));
+                cached -= get<2>(*it);
+                cache.erase(it);
+                return fem;
+            }
+        return make_unique<TFEM<S>>();
+    }
+    // Возврат модели в кэш с вытеснением давно не использовавшихся
+    void put(const string &key, unique_ptr<TFEM<S>> fem)
+    {
+        size_t size = fem->get_memory_size();
+        lock_guard<mutex> lock(mtx);
+
+        cache.emplace_front(key, move(fem), size);
+        cached += size;
+        while (cached > capacity and cache.size())
+        {
+            cached -= get<2>(cache.back());
+            cache.pop_back();
+        }
+    }
+#ifndef _WIN32
+    static bool read_line(int fd, string &str)
+    {
+        char c;
+
+        str.clear();
+        while (str.length() < 4096)
+        {
+            if (::read(fd, &c, 1) not_eq 1)
+                return false;
+            if (c == '\n')
+                return true;
+            str += c;
+        }
+        return false;
+    }
+    static bool write_data(int fd, const char *data, size_t size)
+    {
+        while (size)
+        {
+            ssize_t len = ::write(fd, data, size);
+
+            if (len <= 0)
+                return false;
+            data += len;
+            size -= size_t(len);
+        }
+        return true;
+    }
+    // Выполнение одного задания и передача ответа
+    void process(int fd)
+    {
+        string str,
+               format,
+               prog,
+               key,
+               answer,
+               result;
+        stringstream ss;
+        unique_ptr<TFEM<S>> fem;
+
+        if (not read_line(fd, str))
+        {
+            ::close(fd);
+            return;
+        }
+        ss.str(str);
+        ss >> format >> ws;
+        getline(ss, prog);
+        try
+        {
+            if (format not_eq "text" and format not_eq "binary")
+                throw TError(Message::OutputFormat);
+            key = TFEM<S>::get_mesh_file(prog);
+            fem = take(key);
+            fem->set_program(prog);
+            fem->replace_output(format);
+            result = prog.substr(0, prog.find_last_of(".")) + "." + to_string(getpid()) + "." + to_string(++job);
+            fem->set_result_name(result);
+            result += format == "text" ? ".res" : ".bres";
+            fem->start();
+            answer = read_result(result);
+            remove_result(result);
+            put(key, move(fem));
+            str = "OK " + to_string(answer.length()) + "\n";
+            if (write_data(fd, str.data(), str.length()))
+                write_data(fd, answer.data(), answer.length());
+        }
+        catch (TError &e)
+        {
+            // Модель с ошибкой в кэш не возвращается
+            remove_result(result);
+            str = "ERROR " + e.say() + "\n";
+            write_data(fd, str.data(), str.length());
+        }
+        catch (exception&)
+        {
+            remove_result(result);
+            str = "ERROR " + say_message(Message::InternalError) + "\n";
+            write_data(fd, str.data(), str.length());
+        }
+        ::close(fd);
+    }
+#endif
+    static void remove_result(const string &fname)
+    {
+        error_code ec;
+
+        if (fname.length())
+            filesystem::remove(fname, ec);
+    }
+    static string read_result(const string &fname)
+    {
+        ifstream in(fname, ios::binary);
+        stringstream ss;
+
+        if (not in.is_open())
+            throw TError(Message::ReadFile);
+        ss << in.rdbuf();
+        return ss.str();
+    }
+    void work(void)
+    {
+        while (true)
+        {
+            int fd;
+
+            {
+                unique_lock<mutex> lock(mtx);
+
+                cv.wait(lock, [this] { return jobs.size() or is_stopped; });
+                if (jobs.empty())
+                    return;
+                fd = jobs.front();
+                jobs.pop_front();
+            }
+#ifndef _WIN32
+            process(fd);
+#endif
+        }
+    }
+public:
+    TService(const string &n, unsigned w = thread::hardware_concurrency(), size_t c = size_t(1) << 30) noexcept :
+        name{n}, workers{max(1u, w)}, capacity{c} {}
+    ~TService(void) noexcept = default;
+    // Прием заданий до вызова stop()
+    void run(void)
+    {
+#ifndef _WIN32
+        sockaddr_un addr{};
+        vector<thread> pool;
+        int fd;
+
+        if (name.length() >= sizeof(addr.sun_path) or (listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            throw TError(Message::Socket);
+        // Разрыв соединения клиентом не должен завершать процесс
+        signal(SIGPIPE, SIG_IGN);
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, name.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(name.c_str());
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 or listen(listener, SOMAXCONN) < 0)
+        {
+            ::close(listener);
+            throw TError(Message::Socket);
+        }
+        for (auto i = 0u; i < workers; i++)
+            pool.push_back(thread(&TService::work, this));
+        while ((fd = accept(listener, nullptr, nullptr)) >= 0 or errno == EINTR)
+            if (fd >= 0)
+            {
+                timeval tv{ timeout, 0 };
+                lock_guard<mutex> lock(mtx);
+
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                jobs.push_back(fd);
+                cv.notify_one();
+            }
+        {
+            lock_guard<mutex> lock(mtx);
+
+            is_stopped = true;
+        }
+        cv.notify_all();
+        for (auto &it: pool)
+            it.join();
+        ::close(listener);
+        unlink(name.c_str());
+#else
+        throw TError(Message::Socket);
+#endif
+    }
+    // Прекращение приема заданий (принятые задания выполняются до конца)
+    void stop(void)
+    {
+#ifndef _WIN32
+        if (listener >= 0)
+            shutdown(listener, SHUT_RDWR);
+#endif
+    }
+};
+
+#endif // SERVICE_H
@@ -0,0 +1,187 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include "matrix/matrix.h"
+#include "mesh/mesh.h"
+#include "msg/msg.h"
+
+using namespace std;
+
+// Количество КЭ, обрабатываемых одновременно (по числу double в SIMD-регистре)
+#if defined(__AVX512F__)
+constexpr int batch_width = 8;
+#elif defined(__AVX2__) or defined(__AVX__)
+constexpr int batch_width = 4;
+#elif defined(__SSE2__)
+constexpr int batch_width = 2;
+#else
+constexpr int batch_width = 1;
+#endif
+
+//-----------------------------------------------------------------------
+// Пакетное вычисление геометрии однотипных КЭ:
+// координаты W элементов хранятся в виде "структуры массивов" (SoA),
+// все внутренние циклы идут по номеру элемента в пакете (lane),
+// что позволяет компилятору векторизовать вычисления
+//-----------------------------------------------------------------------
+template <class T, int W = batch_width> class TShapeBatch
+{
+private:
+    static constexpr int n = T::size();
+    static constexpr int q = T::quadrature_degree();
+    // Номер первого КЭ пакета и количество КЭ в нем
+    size_t first = 0;
+    int count = 0;
+    // Координаты узлов: [узел][координата][КЭ]
+    alignas(64) double x[n][3][W];
+    // Расширенная матрица [A|E] для обращения матрицы коэффициентов функций формы
+    alignas(64) double a[n][2 * n][W];
+    // Модуль якобиана в узлах квадратуры: [узел квадратуры][КЭ]
+    alignas(64) double jacobian[q][W];
+    void invert(void)
+    {
+        alignas(64) double f[W];
+
+        for (auto c = 0; c < n; c++)
+        {
+            // Выбор главного элемента (индивидуален для каждого КЭ)
+            for (auto l = 0; l < W; l++)
+            {
+                auto p = c;
+
+                for (auto r = c + 1; r < n; r++)
+                    if (fabs(a[r][c][l]) > fabs(a[p][c][l]))
+                        p = r;
+                if (fabs(a[p][c][l]) < 1.0E-20)
+                    throw TError(Message::InvalidFE);
+                if (p not_eq c)
+                    for (auto k = 0; k < 2 * n; k++)
+                        swap(a[p][k][l], a[c][k][l]);
+            }
+            for (auto l = 0; l < W; l++)
+                f[l] = 1.0 / a[c][c][l];
+            for (auto k = 0; k < 2 * n; k++)
+                for (auto l = 0; l < W; l++)
+                    a[c][k][l] *= f[l];
+            for (auto r = 0; r < n; r++)
+            {
+                if (r == c)
+                    continue;
+                for (auto l = 0; l < W; l++)
+                    f[l] = a[r][c][l];
+                for (auto k = 0; k < 2 * n; k++)
+                    for (auto l = 0; l < W; l++)
+                        a[r][k][l] -= f[l] * a[c][k][l];
+            }
+        }
+    }
+    void calc_jacobian(void)
+    {
+        alignas(64) double j[3][3][W];
+
+        for (auto i = 0; i < q; i++)
+        {
+            for (auto r = 0; r < T::dim(); r++)
+                for (auto c = 0; c < T::dim(); c++)
+                {
+                    for (auto l = 0; l < W; l++)
+                        j[r][c][l] = 0;
+                    for (auto k = 0; k < n; k++)
+                    {
+                        double d = T::dn(i, k, r);
+
+                        for (auto l = 0; l < W; l++)
+                            j[r][c][l] += d * x[k][c][l];
+                    }
+                }
+            for (auto l = 0; l < W; l++)
+                if constexpr (T::dim() == 1)
+                    jacobian[i][l] = fabs(j[0][0][l]);
+                else if constexpr (T::dim() == 2)
+                    jacobian[i][l] = fabs(j[0][0][l] * j[1][1][l] - j[0][1][l] * j[1][0][l]);
+                else
+                    jacobian[i][l] = fabs(j[0][0][l] * j[1][1][l] * j[2][2][l] + j[0][1][l] * j[1][2][l] * j[2][0][l] +
+                                          j[0][2][l] * j[1][0][l] * j[2][1][l] - j[0][2][l] * j[1][1][l] * j[2][0][l] -
+                                          j[0][0][l] * j[1][2][l] * j[2][1][l] - j[0][1][l] * j[1][0][l] * j[2][2][l]);
+        }
+    }
+public:
+    TShapeBatch(void) noexcept {}
+    ~TShapeBatch(void) noexcept = default;
+    static constexpr int width(void) noexcept
+    {
+        return W;
+    }
+    // Упаковка координат КЭ с номерами [start, start + W) (незаполненные позиции дублируют первый КЭ)
+    void pack(TMesh &mesh, size_t start)
+    {
+        matrix<double> px;
+
+        first = start;
+        count = int(min(size_t(W), mesh.get_fe_count() - start));
+        for (auto l = 0; l < W; l++)
+        {
+            px = mesh.get_coord_fe(first + size_t(l < count ? l : 0));
+            for (auto k = 0; k < n; k++)
+            {
+                for (auto j = 0; j < 3; j++)
+                    x[k][j][l] = px(k, j);
+                for (auto j = 0; j < n; j++)
+                {
+                    a[k][j][l] = T::coeff(px, k, j);
+                    a[k][n + j][l] = (k == j) ? 1.0 : 0.0;
+                }
+            }
+        }
+    }
+    // Вычисление коэффициентов функций формы и якобианов для всего пакета
+    void evaluate(void)
+    {
+        invert();
+        calc_jacobian();
+    }
+    int size(void) const noexcept
+    {
+        return count;
+    }
+    size_t index(int l) const noexcept
+    {
+        return first + size_t(l);
+    }
+    // Функции формы l-го КЭ пакета (i-я функция - i-й столбец A^{-1})
+    vector<T> shape(int l) const
+    {
+        vector<T> res;
+        vector<double> c(n);
+
+        for (auto i = 0; i < n; i++)
+        {
+            for (auto k = 0; k < n; k++)
+                c[k] = a[k][n + i][l];
+            res.push_back(T(c));
+        }
+        return res;
+    }
+    matrix<double> coord(int l) const
+    {
+        matrix<double> res(n, 3);
+
+        for (auto k = 0; k < n; k++)
+            for (auto j = 0; j < 3; j++)
+                res(k, j) = x[k][j][l];
+        return res;
+    }
+    vector<double> get_jacobian(int l) const
+    {
+        vector<double> res(q);
+
+        for (auto i = 0; i < q; i++)
+            res[i] = jacobian[i][l];
+        return res;
+    }
+};
+
+#endif // BATCH_H
@@ -30,6 +30,15 @@ struct TShape1d2
     {
         return { { (x(1, 0) - x(0, 0)) * 0.5 } };
     }
+    // Производная k-й функции формы по j-й локальной координате в i-м узле квадратуры
+    inline static double dn(int, int k, int)
+    {
+        return array<double, 2>{ -0.5, 0.5 }[k];
+    }
+    inline static constexpr int dim(void) noexcept
+    {
+        return 1;
+    }
     inline static constexpr int size(void) noexcept
     {
         return 2;
@@ -95,6 +104,14 @@ struct TShape2d3
             }
         return jacobi;
     }
+    inline static double dn(int, int k, int j)
+    {
+        return (j == 0) ? array<double, 3>{ -1.0, 1.0, 0.0 }[k] : array<double, 3>{ -1.0, 0.0, 1.0 }[k];
+    }
+    inline static constexpr int dim(void) noexcept
+    {
+        return 2;
+    }
     inline static constexpr int size(void) noexcept
     {
         return 3;
@@ -164,6 +181,15 @@ struct TShape2d4
             }
         return jacobi;
     }
+    inline static double dn(int i, int k, int j)
+    {
+        return (j == 0) ? array<double, 4>{ -0.25 * (1.0 - eta(i)), 0.25 * (1.0 - eta(i)), 0.25 * (1.0 + eta(i)), -0.25 * (1.0 + eta(i)) }[k] :
+                          array<double, 4>{ -0.25 * (1.0 - xi(i)), -0.25 * (1.0 + xi(i)), 0.25 * (1.0 + xi(i)), 0.25 * (1.0 - xi(i)) }[k];
+    }
+    inline static constexpr int dim(void) noexcept
+    {
+        return 2;
+    }
     inline static constexpr int size(void) noexcept
     {
         return 4;
@@ -238,6 +264,14 @@ struct TShape3d4
             }
         return jacobi;
     }
+    inline static double dn(int, int k, int j)
+    {
+        return (k == 0) ? -1.0 : (k == j + 1) ? 1.0 : 0.0;
+    }
+    inline static constexpr int dim(void) noexcept
+    {
+        return 3;
+    }
     inline static constexpr int size(void) noexcept
     {
         return 4;
@@ -306,6 +340,14 @@ public:
     {
         return T::jacobi(i, x);
     }
+    inline static double dn(int i, int k, int j)
+    {
+        return T::dn(i, k, j);
+    }
+    inline static constexpr int dim(void) noexcept
+    {
+        return T::dim();
+    }
     inline static constexpr int quadrature_degree(void)
     {
         return T::quadrature_degree();
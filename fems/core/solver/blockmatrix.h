@@ -0,0 +1,303 @@
+#ifndef BLOCKMATRIX_H
+#define BLOCKMATRIX_H
+
+#include <algorithm>
+#include <vector>
+#include <Eigen/Sparse>
+#include "matrix/index.h"
+
+using namespace Eigen;
+using namespace std;
+
+// Полное развертывание циклов по блоку фиксированного размера (при -O2 не выполняется компилятором)
+#if defined(__GNUC__) and not defined(__clang__)
+    #define BLOCK_UNROLL _Pragma("GCC unroll 8")
+#elif defined(__clang__)
+    #define BLOCK_UNROLL _Pragma("unroll")
+#else
+    #define BLOCK_UNROLL
+#endif
+
+//-----------------------------------------------------------------------
+// Блочная разреженная матрица (BSR по столбцам): для каждой пары смежных узлов хранится
+// один номер блочной строки и плотный блок freedom x freedom (по столбцам). В симметричном
+// режиме хранятся только блоки над диагональю и верхний треугольник диагональных блоков
+// (нижний треугольник диагонального блока всегда нулевой). Для прямого решателя матрица
+// преобразуется в скалярный формат CSC (to_csc)
+//-----------------------------------------------------------------------
+template <typename T> class TBlockMatrix
+{
+private:
+    size_t size = 0;                // Количество узлов (блочных строк и столбцов)
+    unsigned freedom = 1;           // Размер блока
+    bool is_symmetric = true;
+    vector<size_t> ptr;             // Начала блочных столбцов
+    vector<TIndex> index;           // Номера блочных строк
+    vector<T> values;               // Блоки
+    // Номер блока (i, j) (i, j - номера узлов) или -1
+    ptrdiff_t find_block(size_t i, size_t j) const noexcept
+    {
+        auto first = index.begin() + ptrdiff_t(ptr[j]),
+             last = index.begin() + ptrdiff_t(ptr[j + 1]),
+             it = lower_bound(first, last, TIndex(i));
+
+        return (it == last or *it not_eq TIndex(i)) ? -1 : it - index.begin();
+    }
+    // y += A * x для k векторов (по столбцам длиной size * freedom); F - размер блока (0 - произвольный).
+    // Столбец xj и вклад симметричных блоков в yj накапливаются локально, по всем векторам за один проход по матрице
+    template <unsigned F> void multiply_blocks(const T *x, T *y, size_t k) const
+    {
+        const unsigned f = F ? F : freedom;
+        const size_t n = size * f;
+        vector<T> buffer(2 * f * k);
+        T *xj = buffer.data(),
+          *sum = xj + f * k;
+
+        for (auto j = 0u; j < size; j++)
+        {
+            // Диагональный блок в симметричном режиме - последний в столбце
+            size_t last = ptr[j + 1] - (is_symmetric ? 1 : 0);
+
+            for (auto v = 0u; v < k; v++)
+                for (auto c = 0u; c < f; c++)
+                {
+                    xj[v * f + c] = x[v * n + j * f + c];
+                    sum[v * f + c] = 0;
+                }
+            for (auto b = ptr[j]; b < last; b++)
+            {
+                const T *block = values.data() + b * f * f;
+                size_t i = size_t(index[b]) * f;
+
+                for (auto v = 0u; v < k; v++)
+                {
+                    const T *xi = x + v * n + i,
+                            *xv = xj + v * f;
+                    T *yi = y + v * n + i,
+                      *sv = sum + v * f;
+
+                    if constexpr (F > 0)
+                    {
+                        // Блок фиксированного размера - вычисления в регистрах (без повторного чтения через указатели)
+                        T a[F],
+                          p[F],
+                          q[F];
+
+                        BLOCK_UNROLL
+                        for (auto r = 0u; r < F; r++)
+                        {
+                            a[r] = xi[r];
+                            p[r] = yi[r];
+                        }
+                        BLOCK_UNROLL
+                        for (auto c = 0u; c < F; c++)
+                        {
+                            T s = 0;
+
+                            BLOCK_UNROLL
+                            for (auto r = 0u; r < F; r++)
+                            {
+                                p[r] += block[c * F + r] * xv[c];
+                                s += block[c * F + r] * a[r];
+                            }
+                            q[c] = s;
+                        }
+                        for (auto r = 0u; r < F; r++)
+                            yi[r] = p[r];
+                        if (is_symmetric)
+                            for (auto c = 0u; c < F; c++)
+                                sv[c] += q[c];
+                        continue;
+                    }
+                    // Блок (i, j): yi += B * xj
+                    for (auto c = 0u; c < f; c++)
+                        for (auto r = 0u; r < f; r++)
+                            yi[r] += block[c * f + r] * xv[c];
+                    // Симметричный блок (j, i): yj += B^T * xi
+                    if (is_symmetric)
+                        for (auto c = 0u; c < f; c++)
+                        {
+                            T s = 0;
+
+                            for (auto r = 0u; r < f; r++)
+                                s += block[c * f + r] * xi[r];
+                            sv[c] += s;
+                        }
+                }
+            }
+            if (is_symmetric)
+            {
+                // Диагональный блок хранит верхний треугольник: yj += (U + U^T - D) * xj
+                const T *block = values.data() + last * f * f;
+
+                for (auto v = 0u; v < k; v++)
+                {
+                    const T *xv = xj + v * f;
+                    T *sv = sum + v * f;
+
+                    for (auto c = 0u; c < f; c++)
+                    {
+                        T s = -block[c * f + c] * xv[c];
+
+                        for (auto r = 0u; r < f; r++)
+                        {
+                            sv[r] += block[c * f + r] * xv[c];
+                            s += block[c * f + r] * xv[r];
+                        }
+                        sv[c] += s;
+                    }
+                }
+            }
+            for (auto v = 0u; v < k; v++)
+                for (auto c = 0u; c < f; c++)
+                    y[v * n + j * f + c] += sum[v * f + c];
+        }
+    }
+public:
+    TBlockMatrix(void) noexcept {}
+    ~TBlockMatrix(void) noexcept = default;
+    // Структура матрицы: neighbours(i) - упорядоченный список узлов, смежных с узлом i (без него самого)
+    template <typename N> void create(size_t nodes, unsigned f, bool symmetric, N neighbours)
+    {
+        size = nodes;
+        freedom = f;
+        is_symmetric = symmetric;
+        ptr.assign(size + 1, 0);
+        index.clear();
+        for (auto j = 0u; j < size; j++)
+        {
+            const auto &list = neighbours(j);
+            auto middle = lower_bound(list.begin(), list.end(), TIndex(j));
+
+            index.insert(index.end(), list.begin(), middle);
+            index.push_back(TIndex(j));
+            if (not is_symmetric)
+                index.insert(index.end(), middle, list.end());
+            ptr[j + 1] = index.size();
+        }
+        values.assign(index.size() * freedom * freedom, 0);
+    }
+    void clear(void)
+    {
+        fill(values.begin(), values.end(), 0);
+    }
+    void release(void)
+    {
+        size = 0;
+        ptr.clear();
+        index.clear();
+        values.clear();
+        ptr.shrink_to_fit();
+        index.shrink_to_fit();
+        values.shrink_to_fit();
+    }
+    size_t rows(void) const noexcept
+    {
+        return size * freedom;
+    }
+    size_t blocks(void) const noexcept
+    {
+        return index.size();
+    }
+    // Количество скалярных элементов (в симметричном режиме - верхнего треугольника)
+    size_t nonzeros(void) const noexcept
+    {
+        return is_symmetric ? (index.size() - size) * freedom * freedom + size * freedom * (freedom + 1) / 2 : values.size();
+    }
+    size_t memory_size(void) const noexcept
+    {
+        return ptr.size() * sizeof(size_t) + index.size() * sizeof(TIndex) + values.size() * sizeof(T);
+    }
+    // Элемент (i, j) (скалярные номера); nullptr - вне структуры или в неиспользуемой части симметричной матрицы
+    T *find(size_t i, size_t j) noexcept
+    {
+        ptrdiff_t b;
+
+        if ((is_symmetric and i > j) or (b = find_block(i / freedom, j / freedom)) < 0)
+            return nullptr;
+        return values.data() + size_t(b) * freedom * freedom + (j % freedom) * freedom + i % freedom;
+    }
+    T get(size_t i, size_t j) const noexcept
+    {
+        ptrdiff_t b;
+
+        if (is_symmetric and i > j)
+            swap(i, j);
+        return (b = find_block(i / freedom, j / freedom)) < 0 ? 0 : values[size_t(b) * freedom * freedom + (j % freedom) * freedom + i % freedom];
+    }
+    // Обход хранимых элементов: f(строка, столбец, значение)
+    template <typename F> void for_each(F f)
+    {
+        for (auto j = 0u; j < size; j++)
+            for (auto b = ptr[j]; b < ptr[j + 1]; b++)
+                for (auto c = 0u; c < freedom; c++)
+                    for (auto r = 0u; r < freedom; r++)
+                        if (not is_symmetric or size_t(index[b]) not_eq j or r <= c)
+                            f(size_t(index[b]) * freedom + r, j * freedom + c, values[b * freedom * freedom + c * freedom + r]);
+    }
+    // y = A * x для k векторов, хранящихся по столбцам
+    void multiply(const T *x, T *y, size_t k = 1) const
+    {
+        fill(y, y + rows() * k, 0);
+        switch (freedom)
+        {
+        case 1:
+            multiply_blocks<1>(x, y, k);
+            break;
+        case 2:
+            multiply_blocks<2>(x, y, k);
+            break;
+        case 3:
+            multiply_blocks<3>(x, y, k);
+            break;
+        case 6:
+            multiply_blocks<6>(x, y, k);
+            break;
+        default:
+            multiply_blocks<0>(x, y, k);
+        }
+    }
+    // Скалярная матрица CSC (в симметричном режиме - верхний треугольник)
+    template <typename I> void to_csc(SparseMatrix<T, ColMajor, I> &m) const
+    {
+        size_t nnz = 0;
+
+        m.resize(Index(rows()), Index(rows()));
+        m.resizeNonZeros(Index(nonzeros()));
+        m.outerIndexPtr()[0] = 0;
+        for (auto j = 0u; j < size; j++)
+            for (auto c = 0u; c < freedom; c++)
+            {
+                for (auto b = ptr[j]; b < ptr[j + 1]; b++)
+                    for (auto r = 0u; r < ((is_symmetric and size_t(index[b]) == j) ? c + 1 : freedom); r++)
+                    {
+                        m.innerIndexPtr()[nnz] = I(size_t(index[b]) * freedom + r);
+                        m.valuePtr()[nnz++] = values[b * freedom * freedom + c * freedom + r];
+                    }
+                m.outerIndexPtr()[j * freedom + c + 1] = I(nnz);
+            }
+    }
+    // Значения из скалярной матрицы той же структуры (false - элемент вне структуры матрицы)
+    template <typename I> bool from_csc(const SparseMatrix<T, ColMajor, I> &m)
+    {
+        clear();
+        if (size_t(m.rows()) not_eq rows() or size_t(m.cols()) not_eq rows())
+            return false;
+        for (auto k = 0; k < m.outerSize(); k++)
+            for (typename SparseMatrix<T, ColMajor, I>::InnerIterator it(m, k); it; ++it)
+            {
+                T *p = find(size_t(it.row()), size_t(it.col()));
+
+                if (p == nullptr)
+                {
+                    if (it.value() not_eq T(0))
+                        return false;
+                    continue;
+                }
+                *p = it.value();
+            }
+        return true;
+    }
+};
+
+#endif // BLOCKMATRIX_H
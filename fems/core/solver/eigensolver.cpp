@@ -1,16 +1,109 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <ctime>
+#include <limits>
+#include <shared_mutex>
 #include <Eigen/PardisoSupport>
 #include <Eigen/SparseCholesky>
 #include "mesh/mesh.h"
 #include "solver/eigensolver.h"
+#include "solver/snapshot.h"
 #include "msg/msg.h"
+#include "trace/trace.h"
 
+// Параметры внешней памяти Pardiso задаются переменными окружения, общими для процесса. Они изменяются
+// только под исключительной блокировкой (разложения с бюджетом памяти выполняются по очереди), а остальные
+// вызовы Pardiso и чтение окружения в других потоках (сервис, параметрический расчет) - под разделяемой
+static shared_mutex env_mutex;
 
-bool TEigenSolver::solve(vector<double> &r, double, bool&)
+static void setEnvironment(const string &name, const string &value)
+{
+#ifdef _WIN32
+    _putenv_s(name.c_str(), value.c_str());
+#else
+    setenv(name.c_str(), value.c_str(), 1);
+#endif
+}
+
+void TEigenSolver::setOutOfCore(size_t budget, const string &path)
+{
+    // Режим хранения разложения выбирается при символьном анализе
+    if (budget not_eq ooc_budget)
+        is_analyzed = false;
+    ooc_budget = budget;
+    if (ooc_budget)
+    {
+        shared_lock<shared_mutex> lock(env_mutex);
+        filesystem::path dir = path.empty() ? filesystem::temp_directory_path() : filesystem::path(path);
+        error_code code;
+
+        filesystem::create_directories(dir, code);
+        ooc_prefix = (dir / ("fems-ooc-" + to_string(chrono::steady_clock::now().time_since_epoch().count()))).string();
+    }
+}
+
+// Разложение матрицы (символьный анализ - только при изменении ее структуры)
+void TEigenSolver::factorize(void)
+{
+    TTraceScope trace("factorization", is_block ? block.nonzeros() : size_t(matrix.nonZeros()));
+    TProgress progress;
+    unique_lock<shared_mutex> ooc_lock(env_mutex, defer_lock);
+    shared_lock<shared_mutex> lock(env_mutex, defer_lock);
+
+    // Файлы разложения, не поместившегося в бюджет, удаляются при его освобождении
+    if (not ooc_budget)
+        lock.lock();
+    else
+    {
+        ooc_lock.lock();
+        setEnvironment("MKL_PARDISO_OOC_MAX_CORE_SIZE", to_string(ooc_budget));
+        setEnvironment("MKL_PARDISO_OOC_PATH", ooc_prefix);
+        setEnvironment("MKL_PARDISO_OOC_KEEP_FILE", "0");
+    }
+    progress.set_process(Message::PreparingSystemEquation);
+    // Блочная матрица преобразуется в скалярную (той же структуры при каждом разложении)
+    if (is_block)
+        block.to_csc(matrix);
+    if (not is_mixed)
+        factor_single.reset();
+    else if (not factor_single)
+    {
+        factor_single = make_unique<PardisoLLT<SparseMatrix<float, ColMajor, TIndex>>>();
+        is_analyzed = false;
+    }
+    if (is_mixed)
+    {
+        SparseMatrix<float, ColMajor, TIndex> single = matrix.cast<float>();
+
+        if (not is_analyzed)
+            analyze(*factor_single, single);
+        factor_single->factorize(single);
+    }
+    else
+    {
+        if (not is_analyzed)
+            analyze(factor, matrix);
+        factor.factorize(matrix);
+    }
+    if (is_block)
+        matrix = TSparseMatrix();
+    progress.stop();
+    if ((is_mixed ? factor_single->info() : factor.info()) not_eq Success)
+        throw TError(Message::NotSolution);
+    is_factorized = true;
+    if (ooc_budget)
+    {
+        size_t size = getFactorSize() >> 20;
+
+        cout << say_message(Message::FactorSize) << size << (size > ooc_budget ? say_message(Message::OutOfCore) : "") << endl;
+    }
+}
+
+bool TEigenSolver::solve(vector<double> &r, double eps, bool&)
 {
     TProgress progress;
-    PardisoLLT<SparseMatrix<double>> solver;
 //    SimplicialLLT<SparseMatrix<double>> solver;
     VectorXd x,
              load = Map<VectorXd, Unaligned>(loadVector.data(), unsigned(loadVector.size()));
@@ -20,21 +113,50 @@ bool TEigenSolver::solve(vector<double> &r, double, bool&)
     // print("matr1.txt");
     ///
 
-    progress.set_process(Message::PreparingSystemEquation);
-    solver.compute(matrix);
-    progress.stop();
-    if (solver.info() not_eq Success)
-        throw TError(Message::NotSolution);
+    applyBoundaryConditions();
+    // Разложение выполняется только при изменении матрицы
+    if (not is_factorized)
+        factorize();
 
-    progress.set_process(Message::SolutionSystemEquation);
-    x = solver.solve(load);
-    progress.stop();
+    {
+        TTraceScope trace("solve", loadVector.size());
+        shared_lock<shared_mutex> lock(env_mutex);
 
-    if(solver.info() not_eq Success)
+        progress.set_process(Message::SolutionSystemEquation);
+        if (is_mixed)
+            x = refine(load, eps);
+        else
+            x = factor.solve(load);
+        progress.stop();
+    }
+
+    // Уточнение не достигло невязки eps (матрица плохо обусловлена для одинарной точности) - система
+    // повторно раскладывается в двойной точности (разложение в одинарной точности при этом освобождается);
+    // это разложение используется и для следующих решений
+    if (is_mixed and residual > eps)
+    {
+        cout << say_message(Message::RefinementResidual) << residual << say_message(Message::RefinementIterations) << refinements
+             << say_message(Message::RefinementFailed) << endl;
+        is_mixed = is_analyzed = is_factorized = false;
+        factorize();
+
+        TTraceScope trace("solve", loadVector.size());
+        shared_lock<shared_mutex> lock(env_mutex);
+
+        progress.set_process(Message::SolutionSystemEquation);
+        x = factor.solve(load);
+        progress.stop();
+        refinements = 0;
+        residual = load.norm() == 0 ? 0 : (load - multiply(x)).norm() / load.norm();
+    }
+
+    if (not is_mixed and factor.info() not_eq Success)
         throw TError(Message::NotSolution);
+    if (is_mixed)
+        cout << say_message(Message::RefinementResidual) << residual << say_message(Message::RefinementIterations) << refinements << endl;
 
 //    chrono::system_clock::time_point timer = chrono::system_clock::now();
-    r.resize(unsigned(matrix.rows()));
+    r.resize(loadVector.size());
     for (auto i = 0u; i < r.size(); i++)
         r[i] = x(i);
 //    cout << endl << "Time: " << (double(static_cast< chrono::duration<double> >(chrono::system_clock::now() - timer).count())) << " sec." << endl;
@@ -42,52 +164,138 @@ bool TEigenSolver::solve(vector<double> &r, double, bool&)
     return true;
 }
 
+// Произведение матрицы системы (в двойной точности) на вектор
+VectorXd TEigenSolver::multiply(const VectorXd &x)
+{
+    VectorXd y(x.size());
+
+    if (is_block)
+        block.multiply(x.data(), y.data());
+    else if (is_symmetric)
+        y = matrix.selfadjointView<Upper>() * x;
+    else
+        y = matrix * x;
+    return y;
+}
+
+// Итерационное уточнение решения, полученного с разложением в одинарной точности:
+// x += A_s^-1 * (b - A * x) до относительной невязки eps или прекращения ее уменьшения
+// (достигнутая невязка проверяется в solve)
+VectorXd TEigenSolver::refine(const VectorXd &b, double eps)
+{
+    // Уменьшение невязки за итерацию, ниже которого уточнение прекращается
+    const double min_ratio = 0.5;
+    const unsigned max_iterations = 100;
+    VectorXd x = VectorXd::Zero(b.size()),
+             res = b;
+    double norm = b.norm(),
+           previous = numeric_limits<double>::max();
+
+    residual = 0;
+    refinements = 0;
+    if (norm == 0)
+        return x;
+    for (refinements = 1; refinements <= max_iterations; refinements++)
+    {
+        // Невязка нормируется, чтобы ее значения оставались в диапазоне одинарной точности
+        double scale = res.norm();
+        VectorXf correction = factor_single->solve(VectorXf((res / scale).cast<float>()));
+
+        if (factor_single->info() not_eq Success)
+            throw TError(Message::NotSolution);
+        x += correction.cast<double>() * scale;
+        res = b - multiply(x);
+        residual = res.norm() / norm;
+        if (residual <= eps or residual > min_ratio * previous)
+            break;
+        previous = residual;
+    }
+    refinements = min(refinements, max_iterations);
+    return x;
+}
+
 void TEigenSolver::setup(TMesh &mesh)
 {
-    int size = (int)mesh.get_x().size1(),
-        freedom = mesh.get_freedom();
+    TIndex size = TIndex(mesh.get_x().size1()),
+           freedom = mesh.get_freedom();
 
-    // Резервируем объем необходимой памяти
+    // Резервируем объем необходимой памяти: в столбце - по freedom элементов на каждый смежный узел
+    // (для верхнего треугольника - только на узлы с меньшим номером и диагональный блок до j-го элемента)
+    loadVector.assign(size * freedom, 0);
+    boundary.clear();
+    is_factorized = is_analyzed = false;
+    if (is_block)
+    {
+        // Структура блочной матрицы строится сразу по карте связей сетки
+        matrix = TSparseMatrix();
+        block.create(size_t(size), unsigned(freedom), is_symmetric, [&mesh](size_t i) -> const vector<TIndex>& { return mesh.get_mesh_map(i); });
+        return;
+    }
+    block.release();
     memMap.resize(size * freedom);
-    for (int i = 0; i < size; i++)
-        for (int j = 0; j < freedom; j++)
-            memMap[i * freedom + j] = (int)mesh.get_mesh_map(i).size() * freedom * freedom;
+    for (TIndex i = 0; i < size; i++)
+        for (TIndex j = 0; j < freedom; j++)
+            if (is_symmetric)
+                memMap[i * freedom + j] = TIndex(lower_bound(mesh.get_mesh_map(size_t(i)).begin(), mesh.get_mesh_map(size_t(i)).end(), i) - mesh.get_mesh_map(size_t(i)).begin()) * freedom + j + 1;
+            else
+                memMap[i * freedom + j] = TIndex(mesh.get_mesh_map(size_t(i)).size() + 1) * freedom;
 
     matrix.resize(size * freedom, size * freedom);
     matrix.setZero();
     matrix.reserve(memMap);
-    loadVector.resize(size * freedom, 0);
     memMap.resize(0);
 }
 
-void TEigenSolver::setBoundaryCondition(unsigned index, double value)
+// Граничное условие: недиагональные элементы строки и столбца index получают значение value
+// (вносятся в матрицу при ее следующем использовании - строка верхнего треугольника не хранится
+// в одном столбце, поэтому все условия учитываются за один проход по матрице)
+void TEigenSolver::setBoundaryCondition(TIndex index, double value)
 {
-    for (Eigen::SparseMatrix<double>::InnerIterator i(matrix, index); i; ++i)
-    {
-        if (i.row() not_eq i.col())
-        {
-            matrix.coeffRef(i.row(), i.col()) = value;
-            matrix.coeffRef(i.col(), i.row()) = value;
-        }
-    }
-    loadVector[index] = value * matrix.coeffRef(index, index);
+    boundary.push_back({ index, value });
+    is_factorized = false;
+    loadVector[index] = value * (is_block ? block.get(index, index) : matrix.coeffRef(index, index));
 //    stiffnessMatrix.coeffRef(index, index) *= 1.0E+8;
 //    loadVector[index] *= 1.0E+8 * value;
 }
 
+void TEigenSolver::applyBoundaryConditions(void)
+{
+    vector<TIndex> order;
+
+    if (boundary.empty())
+        return;
+    // Для элемента, строка и столбец которого заданы в разных условиях, действует заданное последним
+    auto apply = [&](size_t row, size_t col, double &value)
+    {
+        if (row not_eq col and max(order[row], order[col]) >= 0)
+            value = boundary[size_t(max(order[row], order[col]))].second;
+    };
+
+    order.assign(loadVector.size(), -1);
+    for (size_t i = 0; i < boundary.size(); i++)
+        order[size_t(boundary[i].first)] = TIndex(i);
+    if (is_block)
+        block.for_each(apply);
+    else
+        for (auto k = 0; k < matrix.outerSize(); k++)
+            for (TSparseMatrix::InnerIterator it(matrix, k); it; ++it)
+                apply(size_t(it.row()), size_t(it.col()), it.valueRef());
+    boundary.clear();
+}
+
 void TEigenSolver::print(string fname)
 {
-    unsigned sz = unsigned(loadVector.size());
+    TIndex sz = TIndex(loadVector.size());
     double res;
     fstream out(fname, ios::out);
 
     out << sz << 'x' << sz + 1 << endl;
     out.setf( std::ios::fixed, std:: ios::floatfield );
-    for (unsigned i = 0; i < sz; i++)
+    for (TIndex i = 0; i < sz; i++)
     {
-        for (unsigned j = 0; j < sz; j++)
+        for (TIndex j = 0; j < sz; j++)
         {
-            res = matrix.coeff(i,j);
+            res = getMatrix(i, j);
             out.precision(10);
             out.width(20);
             out << res << ' ';
@@ -99,49 +307,50 @@ void TEigenSolver::print(string fname)
     out.close();
 }
 
-bool TEigenSolver::saveMatrix(string fname, SparseMatrix<double>& globalMatrix)
+// Запись матрицы в виде снимка CSC (см. snapshot.h)
+bool TEigenSolver::saveMatrix(string fname, TSparseMatrix& globalMatrix)
 {
-    fstream out(fname, ios::out | ios::binary);
-    int signature = 12031971,
-        len = 0;
-    double val;
+    applyBoundaryConditions();
+    if (is_block and &globalMatrix == &matrix)
+    {
+        // Скалярная копия нужна только на время записи
+        bool ret;
 
-    if (not out.is_open())
-        return false;
-    // Запись сигнатуры
-    out.write(reinterpret_cast<char*>(&signature), sizeof(int));
-    // Вычисление количества ненулевых элементов
-    for (int k = 0; k < globalMatrix.outerSize(); ++k)
-        for (SparseMatrix<double>::InnerIterator it(globalMatrix,k); it; ++it)
-            len++;
-    out.write(reinterpret_cast<char*>(&len), sizeof(int));
-    // Запись ненулевых элементов
-    for (int k = 0; k < globalMatrix.outerSize(); ++k)
-        for (SparseMatrix<double>::InnerIterator it(globalMatrix,k); it; ++it)
-        {
-            out.write(reinterpret_cast<char*>(&(len = int(it.row()))), sizeof(int));
-            out.write(reinterpret_cast<char*>(&(len = int(it.col()))), sizeof(int));
-            out.write(reinterpret_cast<char*>(&(val = int(it.value()))), sizeof(double));
-        }
-    out.close();
-    return not out.fail();
+        block.to_csc(globalMatrix);
+        ret = write_snapshot(fname, globalMatrix);
+        globalMatrix = TSparseMatrix();
+        return ret;
+    }
+    globalMatrix.makeCompressed();
+    return write_snapshot(fname, globalMatrix);
 }
 
-bool TEigenSolver::loadMatrix(string fname, SparseMatrix<double>& globalMatrix)
+bool TEigenSolver::loadMatrix(string fname, TSparseMatrix& globalMatrix)
 {
     int len,
         signature,
         row,
         col;
     double val;
-    fstream in(fname, ios::in | ios::binary);
+    vector<Triplet<double, TIndex>> data;
+    TSparseMatrix m(Index(loadVector.size()), Index(loadVector.size()));
+    TMatrixSnapshot<double, TIndex> snapshot;
+    fstream in;
 
+    // Снимок CSC копируется в матрицу без перестроения (при несовпадении размеров с системой
+    // или неверной структуре матрица собирается заново)
+    if (TMatrixSnapshot<double, TIndex>::is_snapshot(fname))
+    {
+        if (not snapshot.open(fname) or size_t(snapshot.rows()) not_eq loadVector.size() or snapshot.cols() not_eq snapshot.rows())
+            return false;
+        snapshot.copy_to(globalMatrix);
+        return setStorage(globalMatrix);
+    }
+    // Прежний формат: последовательность троек (строка, столбец, значение)
+    in.open(fname, ios::in | ios::binary);
     if (not in.is_open())
         return false;
 
-    // Резервируем объем необходимой памяти
-    globalMatrix.setZero();
-    globalMatrix.reserve(memMap);
     in.read(reinterpret_cast<char*>(&signature), sizeof(int));
     if (signature not_eq 12031971)
     {
@@ -149,27 +358,62 @@ bool TEigenSolver::loadMatrix(string fname, SparseMatrix<double>& globalMatrix)
         return false;
     }
     in.read(reinterpret_cast<char*>(&len), sizeof(int));
-
-
+    if (in.fail() or len < 0)
+        return false;
+    data.reserve(unsigned(len));
     for (int i = 0; i < len; i++)
     {
         in.read(reinterpret_cast<char*>(&row), sizeof(int));
         in.read(reinterpret_cast<char*>(&col), sizeof(int));
         in.read(reinterpret_cast<char*>(&val), sizeof(double));
-        if (in.good())
-            globalMatrix.coeffRef(row,col) = val;
-        else
-            break;
+        if (not in.good() or row < 0 or col < 0 or row >= m.rows() or col >= m.cols())
+            return false;
+        data.push_back(Triplet<double, TIndex>(row, col, val));
     }
     in.close();
-    return not in.fail();
+    // Матрица строится за один проход вместо поэлементной вставки
+    m.setFromTriplets(data.begin(), data.end());
+    globalMatrix = move(m);
+    return setStorage(globalMatrix);
 }
 
-void TEigenSolver::product(SparseMatrix<double>& matr, vector<double>& vec, vector<double>& res)
+// Приведение загруженной симметричной матрицы к текущему режиму хранения
+// (файл мог быть записан как с полной матрицей, так и с верхним треугольником)
+// (при блочном хранении значения переносятся в блочную матрицу; false - структура не совпадает)
+bool TEigenSolver::setStorage(TSparseMatrix &m)
+{
+    bool ret = true;
+
+    if (is_symmetric)
+        m = TSparseMatrix(m.triangularView<Upper>());
+    else
+        m = TSparseMatrix(m.selfadjointView<Upper>());
+    if (is_block and &m == &matrix)
+    {
+        ret = block.from_csc(m);
+        m = TSparseMatrix();
+    }
+    boundary.clear();
+    is_factorized = is_analyzed = false;
+    return ret;
+}
+
+void TEigenSolver::product(TSparseMatrix& matr, vector<double>& vec, vector<double>& res)
 {
     VectorXd tmp = Map<VectorXd, Unaligned>(vec.data(), unsigned(vec.size()));
 
-    tmp = matr * tmp;
+    if (&matr == &matrix)
+    {
+        applyBoundaryConditions();
+        // Блочное умножение (матрица после разложения в скалярном виде не хранится)
+        if (is_block)
+        {
+            res.resize(vec.size());
+            block.multiply(vec.data(), res.data());
+            return;
+        }
+    }
+    tmp = is_symmetric ? VectorXd(matr.selfadjointView<Upper>() * tmp) : VectorXd(matr * tmp);
     res.resize(tmp.size());
     VectorXd::Map(&res[0], tmp.size()) = tmp;
 }
@@ -1,49 +1,214 @@
 #ifndef EIGENSOLVER_H
 #define EIGENSOLVER_H
 
+#include <memory>
 #include <mutex>
+#include <string>
 #include <Eigen/Sparse>
+#include <Eigen/PardisoSupport>
 #include "solver.h"
+#include "blockmatrix.h"
 
 using namespace Eigen;
 using namespace std;
 
 class TMesh;
 
-class TEigenSolver : public TSolver<SparseMatrix<double>>
+// Глобальная матрица с индексами разрядности TIndex
+using TSparseMatrix = SparseMatrix<double, ColMajor, TIndex>;
+
+class TEigenSolver : public TSolver<TSparseMatrix>
 {
 private:
-    VectorXi memMap;
+    Matrix<TIndex, Dynamic, 1> memMap;
     mutex mtx;
-    bool loadMatrix(string, SparseMatrix<double>&);
-    bool saveMatrix(string, SparseMatrix<double>&);
+    // Разложение матрицы, сохраняемое для повторных решений с другой правой частью
+    PardisoLLT<TSparseMatrix> factor;
+    // Разложение в одинарной точности (смешанная точность: точность решения восстанавливается
+    // итерационным уточнением по матрице в двойной точности); освобождается при переходе к двойной точности
+    unique_ptr<PardisoLLT<SparseMatrix<float, ColMajor, TIndex>>> factor_single;
+    // (если уточнение не достигает заданной невязки, решатель переходит к двойной точности)
+    bool is_mixed = false;
+    // Достигнутая относительная невязка и количество итераций уточнения последнего решения
+    double residual = 0;
+    unsigned refinements = 0;
+    // Символьный анализ (упорядочение и структура разложения) выполнен для текущей структуры матрицы
+    bool is_analyzed = false;
+    // Бюджет оперативной памяти разложения (Мб, 0 - не ограничен) и префикс файлов разложения, вытесняемого на диск
+    size_t ooc_budget = 0;
+    string ooc_prefix;
+    // Хранение только верхнего треугольника симметричной матрицы (его и использует разложение)
+    bool is_symmetric = true;
+    // Блочное хранение (по узлам); скалярная матрица формируется только для разложения
+    bool is_block = false;
+    TBlockMatrix<double> block;
+    // Граничные условия, еще не внесенные в матрицу (индекс и значение в порядке задания)
+    vector<pair<TIndex, double>> boundary;
+    void applyBoundaryConditions(void);
+    bool setStorage(TSparseMatrix&);
+    VectorXd multiply(const VectorXd&);
+    VectorXd refine(const VectorXd&, double);
+    void factorize(void);
+    bool loadMatrix(string, TSparseMatrix&);
+    bool saveMatrix(string, TSparseMatrix&);
+    // Символьный анализ; при заданном бюджете памяти Pardiso сам переходит к хранению разложения на диске
+    // (iparm[59] = 1), если оно не помещается в бюджет
+    template <typename F, typename M> void analyze(F &f, const M &m)
+    {
+        f.pardisoParameterArray()[59] = ooc_budget ? 1 : 0;
+        f.analyzePattern(m);
+        is_analyzed = f.info() == Success;
+    }
+    // Объем разложения: после символьного анализа Pardiso сообщает количество ненулевых элементов
+    // множителя (iparm[17]), до него заполнение принимается равным fill_factor
+    size_t getFactorSize(void)
+    {
+        const size_t fill_factor = 5;
+        // Число ненулевых элементов разложения (iparm[17]) имеет тип индекса Pardiso (64 бита при FEMS_INDEX64)
+        TIndex factor_nnz = is_mixed and factor_single ? factor_single->pardisoParameterArray()[17] : factor.pardisoParameterArray()[17];
+        size_t nnz = is_block ? block.nonzeros() : size_t(matrix.nonZeros());
+
+        if (is_analyzed and factor_nnz > 0)
+            nnz = size_t(factor_nnz);
+        else
+            nnz *= fill_factor;
+        return nnz * ((is_mixed ? sizeof(float) : sizeof(double)) + sizeof(TIndex)) + (loadVector.size() + 1) * sizeof(TIndex);
+    }
 public:
+    using TSolver<TSparseMatrix>::loadMatrix;
+    using TSolver<TSparseMatrix>::saveMatrix;
+    using TSolver<TSparseMatrix>::getMatrix;
     TEigenSolver(void) {}
     virtual ~TEigenSolver(void) {}
     void setup(TMesh&);
-    void setBoundaryCondition(unsigned, double);
+    void setBoundaryCondition(TIndex, double);
     void clear(void)
     {
         matrix.resize(0, 0);
         memMap.resize(0);
+        block.release();
         loadVector.clear();
+        boundary.clear();
+        is_factorized = is_analyzed = false;
+    }
+    void clearMatrix(void)
+    {
+        if (is_block)
+            block.clear();
+        else
+            for (auto k = 0; k < matrix.outerSize(); k++)
+                for (TSparseMatrix::InnerIterator it(matrix, k); it; ++it)
+                    it.valueRef() = 0;
+        std::fill(loadVector.begin(), loadVector.end(), 0);
+        boundary.clear();
+        is_factorized = false;
+    }
+    // Режим хранения устанавливается до setup
+    void setSymmetric(bool symmetric)
+    {
+        is_symmetric = symmetric;
+    }
+    bool isSymmetric(void) const
+    {
+        return is_symmetric;
+    }
+    void setMixed(bool mixed)
+    {
+        is_mixed = mixed;
+    }
+    bool isMixed(void) const
+    {
+        return is_mixed;
+    }
+    double getResidual(void) const
+    {
+        return residual;
+    }
+    unsigned getRefinements(void) const
+    {
+        return refinements;
+    }
+    // Разложение с внешней памятью: budget - объем оперативной памяти разложения (Мб, 0 - без ограничения),
+    // path - каталог временных файлов (пустой - системный временный каталог)
+    void setOutOfCore(size_t, const string&);
+    size_t getOutOfCore(void) const
+    {
+        return ooc_budget;
+    }
+    void setBlock(bool b)
+    {
+        is_block = b;
+    }
+    bool isBlock(void) const
+    {
+        return is_block;
     }
-    void product(SparseMatrix<double>&, vector<double>&, vector<double>&);
-    void setMatrix(double value, unsigned i, unsigned j)
+    void product(TSparseMatrix&, vector<double>&, vector<double>&);
+    void setMatrix(double value, TIndex i, TIndex j)
     {
-        matrix.coeffRef(i, j) = value;
+        if (is_symmetric and i > j)
+            swap(i, j);
+        if (not is_block)
+            matrix.coeffRef(i, j) = value;
+        else if (auto p = block.find(i, j))
+            *p = value;
+        is_factorized = false;
     }
-    void addMatrix(double value, unsigned i, unsigned j)
+    // При хранении верхнего треугольника элемент (i, j), i > j, добавляется в (j, i), как и в setMatrix
+    void addMatrix(double value, TIndex i, TIndex j)
     {
         lock_guard<mutex> guard(mtx);
-        matrix.coeffRef(i, j) += value;
+
+        if (is_symmetric and i > j)
+            swap(i, j);
+        if (not is_block)
+            matrix.coeffRef(i, j) += value;
+        else if (auto p = block.find(i, j))
+            *p += value;
+        is_factorized = false;
+    }
+    // Добавление значения в элементы (i, j) и (j, i) симметричной матрицы
+    void addSymmetric(double value, TIndex i, TIndex j)
+    {
+        lock_guard<mutex> guard(mtx);
+
+        if (is_block)
+        {
+            if (auto p = block.find(is_symmetric ? min(i, j) : i, is_symmetric ? max(i, j) : j))
+                *p += value;
+            if (auto p = (is_symmetric or i == j) ? nullptr : block.find(j, i))
+                *p += value;
+        }
+        else if (is_symmetric or i == j)
+            matrix.coeffRef(min(i, j), max(i, j)) += value;
+        else
+        {
+            matrix.coeffRef(i, j) += value;
+            matrix.coeffRef(j, i) += value;
+        }
+        is_factorized = false;
     }
     void print(string);
-    double getMatrix(unsigned i, unsigned j)
+    double getMatrix(TIndex i, TIndex j)
     {
-        return matrix.coeff(i, j);
+        applyBoundaryConditions();
+        if (is_block)
+            return block.get(i, j);
+        return (is_symmetric and i > j) ? matrix.coeff(j, i) : matrix.coeff(i, j);
     }
     bool solve(vector<double>&, double, bool&);
+    size_t getMemorySize(void)
+    {
+        size_t nnz = is_block ? block.nonzeros() : size_t(matrix.nonZeros()),
+               size = nnz * (sizeof(double) + sizeof(TIndex)) + (loadVector.size() + 1) * sizeof(TIndex),
+               factor_size = is_factorized ? getFactorSize() : 0;
+
+        // Разложение, вытесняемое на диск, занимает в оперативной памяти не более бюджета
+        if (ooc_budget)
+            factor_size = min(factor_size, ooc_budget << 20);
+        // При блочном хранении скалярная матрица после разложения не хранится
+        return (is_block ? block.memory_size() : size) + factor_size + loadVector.size() * sizeof(double) + size_t(memMap.size()) * sizeof(TIndex);
+    }
 };
 
 #endif // EIGENSOLVER_H
@@ -0,0 +1,169 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <Eigen/Sparse>
+#include "file/mapfile.h"
+
+using namespace Eigen;
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Снимок разреженной матрицы в формате CSC (по столбцам): заголовок и три непрерывных
+// массива (начала столбцов, номера строк, значения), выровненных на 8 байт
+//-----------------------------------------------------------------------
+struct TSnapshotHeader
+{
+    char signature[8];          // "FEMSCSC"
+    uint32_t version;
+    uint32_t index_size;        // Размер индекса в байтах
+    uint32_t value_size;        // Размер значения в байтах
+    uint32_t flags;             // Зарезервировано
+    int64_t rows;
+    int64_t cols;
+    int64_t nnz;
+    uint64_t outer_offset;
+    uint64_t inner_offset;
+    uint64_t value_offset;
+};
+
+constexpr char snapshot_signature[8] = "FEMSCSC";
+constexpr uint32_t snapshot_version = 1;
+
+inline uint64_t snapshot_align(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Запись матрицы (должна быть в сжатом виде) в файл снимка
+template <typename T, typename I> bool write_snapshot(const string &fname, const SparseMatrix<T, ColMajor, I> &m)
+{
+    TSnapshotHeader header;
+    ofstream out(fname, ios::binary);
+    char pad[8] = { 0 };
+    auto write = [&](const void *data, uint64_t offset, uint64_t size)
+    {
+        out.write(pad, streamsize(offset - uint64_t(out.tellp())));
+        out.write(static_cast<const char*>(data), streamsize(size));
+    };
+
+    if (not out.is_open() or not m.isCompressed())
+        return false;
+    memcpy(header.signature, snapshot_signature, sizeof(header.signature));
+    header.version = snapshot_version;
+    header.index_size = sizeof(I);
+    header.value_size = sizeof(T);
+    header.flags = 0;
+    header.rows = m.rows();
+    header.cols = m.cols();
+    header.nnz = m.nonZeros();
+    header.outer_offset = snapshot_align(sizeof(TSnapshotHeader));
+    header.inner_offset = snapshot_align(header.outer_offset + uint64_t(header.cols + 1) * sizeof(I));
+    header.value_offset = snapshot_align(header.inner_offset + uint64_t(header.nnz) * sizeof(I));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(m.outerIndexPtr(), header.outer_offset, uint64_t(header.cols + 1) * sizeof(I));
+    write(m.innerIndexPtr(), header.inner_offset, uint64_t(header.nnz) * sizeof(I));
+    write(m.valuePtr(), header.value_offset, uint64_t(header.nnz) * sizeof(T));
+    out.close();
+    return not out.fail();
+}
+
+//-----------------------------------------------------------------------
+// Снимок матрицы, отображенный в память: доступ к матрице через Map
+// без построения ее копии
+//-----------------------------------------------------------------------
+template <typename T = double, typename I = typename SparseMatrix<T>::StorageIndex> class TMatrixSnapshot
+{
+private:
+    TMappedFile file;
+    const TSnapshotHeader *header = nullptr;
+public:
+    TMatrixSnapshot(void) noexcept {}
+    ~TMatrixSnapshot(void) noexcept = default;
+    static bool is_snapshot(const string &fname)
+    {
+        char signature[sizeof(snapshot_signature)] = { 0 };
+        ifstream in(fname, ios::binary);
+
+        in.read(signature, sizeof(signature));
+        return in.good() and memcmp(signature, snapshot_signature, sizeof(signature)) == 0;
+    }
+    bool open(const string &fname)
+    {
+        header = nullptr;
+        if (not file.open(fname))
+            return false;
+        if (not (header = file.at<TSnapshotHeader>(0)) or memcmp(header->signature, snapshot_signature, sizeof(snapshot_signature)) or
+            header->version not_eq snapshot_version or header->index_size not_eq sizeof(I) or header->value_size not_eq sizeof(T) or
+            header->rows < 0 or header->cols < 0 or header->nnz < 0 or
+            not file.at<I>(header->outer_offset, size_t(header->cols + 1)) or not file.at<I>(header->inner_offset, size_t(header->nnz)) or
+            not file.at<T>(header->value_offset, size_t(header->nnz)) or not is_valid())
+        {
+            header = nullptr;
+            file.close();
+            return false;
+        }
+        return true;
+    }
+    // Проверка структуры CSC: начала столбцов не убывают (от 0 до nnz), номера строк в столбце
+    // возрастают и лежат в [0, rows) - файл кэша мог быть усечен или записан другой программой
+    bool is_valid(void) const
+    {
+        const I *po = outer(),
+                *pi = inner();
+
+        if (po[0] not_eq 0 or po[header->cols] not_eq header->nnz)
+            return false;
+        for (int64_t j = 0; j < header->cols; j++)
+        {
+            if (po[j + 1] < po[j])
+                return false;
+            for (int64_t k = po[j]; k < po[j + 1]; k++)
+                if (pi[k] < 0 or pi[k] >= header->rows or (k > po[j] and pi[k] <= pi[k - 1]))
+                    return false;
+        }
+        return true;
+    }
+    const I *outer(void) const
+    {
+        return file.at<I>(header->outer_offset, size_t(header->cols + 1));
+    }
+    const I *inner(void) const
+    {
+        return file.at<I>(header->inner_offset, size_t(header->nnz));
+    }
+    const T *values(void) const
+    {
+        return file.at<T>(header->value_offset, size_t(header->nnz));
+    }
+    Index rows(void) const
+    {
+        return Index(header->rows);
+    }
+    Index cols(void) const
+    {
+        return Index(header->cols);
+    }
+    Index nonZeros(void) const
+    {
+        return Index(header->nnz);
+    }
+    Map<const SparseMatrix<T, ColMajor, I>> matrix(void) const
+    {
+        return Map<const SparseMatrix<T, ColMajor, I>>(rows(), cols(), nonZeros(), outer(), inner(), values());
+    }
+    // Копирование снимка в матрицу тремя блочными копированиями массивов
+    void copy_to(SparseMatrix<T, ColMajor, I> &m) const
+    {
+        m.resize(rows(), cols());
+        m.resizeNonZeros(nonZeros());
+        memcpy(m.outerIndexPtr(), outer(), size_t(cols() + 1) * sizeof(I));
+        memcpy(m.innerIndexPtr(), inner(), size_t(nonZeros()) * sizeof(I));
+        memcpy(m.valuePtr(), values(), size_t(nonZeros()) * sizeof(T));
+    }
+};
+
+#endif // SNAPSHOT_H
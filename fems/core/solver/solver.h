@@ -3,6 +3,7 @@
 
 #include <string>
 #include "matrix/matrix.h"
+#include "matrix/index.h"
 
 using namespace std;
 
@@ -13,29 +14,48 @@ template <class T> class TSolver
 protected:
     T matrix;
     vector<double> loadVector;
+    // Признак наличия разложения текущей матрицы (сбрасывается при ее изменении)
+    bool is_factorized = false;
     virtual bool loadMatrix(string, T&) = 0;
     virtual bool saveMatrix(string, T&) = 0;
 public:
     TSolver(void) {}
     virtual ~TSolver(void) {}
     virtual void clear(void) = 0;
-    virtual void setBoundaryCondition(unsigned, double) = 0;
+    virtual void setBoundaryCondition(TIndex, double) = 0;
     virtual void setup(TMesh&) = 0;
-    virtual void setMatrix(double, unsigned, unsigned) = 0;
-    virtual void addMatrix(double, unsigned, unsigned) = 0;
-    void setLoad(unsigned i, double value)
+    // Обнуление матрицы и правой части с сохранением структуры матрицы, сформированной для той же сетки
+    virtual void clearMatrix(void) = 0;
+    virtual void setMatrix(double, TIndex, TIndex) = 0;
+    virtual void addMatrix(double, TIndex, TIndex) = 0;
+    // Добавление значения в симметричную пару элементов (i, j) и (j, i)
+    virtual void addSymmetric(double, TIndex, TIndex) = 0;
+    void setLoad(TIndex i, double value)
     {
         loadVector[i] = value;
     }
-    void addLoad(double value, unsigned i)
+    void addLoad(double value, TIndex i)
     {
         loadVector[i] += value;
     }
-    double getLoad(unsigned i)
+    double getLoad(TIndex i)
     {
         return loadVector[i];
     }
-    virtual double getMatrix(unsigned, unsigned) = 0;
+    // Учет граничного условия только в правой части (матрица уже содержит его)
+    void setBoundaryLoad(TIndex i, double value)
+    {
+        loadVector[i] = value * getMatrix(i, i);
+    }
+    void clearLoad(void)
+    {
+        std::fill(loadVector.begin(), loadVector.end(), 0);
+    }
+    bool isFactorized(void) const
+    {
+        return is_factorized;
+    }
+    virtual double getMatrix(TIndex, TIndex) = 0;
     T& getMatrix(void)
     {
         return matrix;
@@ -46,6 +66,8 @@ public:
     }
     virtual bool solve(vector<double>&, double, bool&) = 0;
     virtual void print(string) = 0;
+    // Оценка объема памяти, занимаемой системой уравнений и ее разложением (байт)
+    virtual size_t getMemorySize(void) = 0;
     bool saveMatrix(string fname)
     {
         return saveMatrix(fname, matrix);
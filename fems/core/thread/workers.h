@@ -0,0 +1,31 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Число рабочих потоков, используемых при параллельной обработке (запись и сжатие результатов,
+// форматирование текстовых файлов, генерация сеток). По умолчанию - число ядер процессора;
+// ограничение задается для всего процесса (fems --threads n, замеры масштабируемости)
+//-----------------------------------------------------------------------
+class TWorkers
+{
+private:
+    static inline atomic<unsigned> limit{0};
+public:
+    static unsigned count(void) noexcept
+    {
+        return limit ? unsigned(limit) : max(1u, thread::hardware_concurrency());
+    }
+    // 0 - без ограничения
+    static void set_count(unsigned n) noexcept
+    {
+        limit = n;
+    }
+};
+
+#endif // WORKERS_H
@@ -0,0 +1,107 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Аппаратные счетчики производительности (perf_event_open, только Linux): такты,
+// инструкции, промахи кэша последнего уровня и ошибки предсказания переходов
+// в пользовательском режиме для текущего потока и потоков, созданных им после запуска.
+// Счетчики открываются независимо (наследование потоками несовместимо с чтением группы);
+// если их больше, чем регистров PMU, ядро поочередно переключает их, и значение масштабируется
+// на отношение времени включения счетчика к времени его работы.
+// Недоступный счетчик (другая ОС, ограничение kernel.perf_event_paranoid,
+// виртуальная машина без PMU) имеет значение -1
+//-----------------------------------------------------------------------
+class TPerfCounters
+{
+public:
+    enum Counter { Cycles = 0, Instructions, CacheMisses, BranchMisses, Count };
+private:
+    array<int, Count> fd;
+#ifdef __linux__
+    static int open_counter(uint64_t config) noexcept
+    {
+        perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+public:
+    TPerfCounters(void) noexcept
+    {
+        fd.fill(-1);
+    }
+    TPerfCounters(const TPerfCounters&) = delete;
+    TPerfCounters &operator = (const TPerfCounters&) = delete;
+    ~TPerfCounters(void) noexcept
+    {
+#ifdef __linux__
+        for (auto it: fd)
+            if (it >= 0)
+                close(it);
+#endif
+    }
+    void start(void) noexcept
+    {
+#ifdef __linux__
+        const array<uint64_t, Count> config{ PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+        for (auto i = 0; i < Count; i++)
+            if ((fd[i] = open_counter(config[i])) >= 0)
+            {
+                ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+    // Значения счетчиков с момента start
+    array<int64_t, Count> stop(void) noexcept
+    {
+        array<int64_t, Count> ret;
+
+        ret.fill(-1);
+#ifdef __linux__
+        for (auto i = 0; i < Count; i++)
+            if (fd[i] >= 0)
+            {
+                // Значение, время включения и время работы счетчика (нс)
+                uint64_t val[3];
+
+                ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd[i], val, sizeof(val)) == sizeof(val) and val[2] > 0)
+                    ret[i] = val[2] < val[1] ? int64_t(double(val[0]) * double(val[1]) / double(val[2])) : int64_t(val[0]);
+                close(fd[i]);
+                fd[i] = -1;
+            }
+#endif
+        return ret;
+    }
+    static const char *name(int i) noexcept
+    {
+        const char *names[] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+        return names[i];
+    }
+};
+
+#endif // COUNTERS_H
@@ -0,0 +1,190 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fstream>
+#ifndef _WIN32
+    #include <sys/resource.h>
+#endif
+#include "msg/msg.h"
+#include "trace/counters.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Трассировка этапов расчета: для каждого этапа запоминаются время начала,
+// астрономическое и процессорное время, пиковый объем резидентной памяти процесса
+// и количество обработанных элементов, а по запросу - аппаратные счетчики (см. counters.h).
+// События накапливаются отдельно в каждом
+// потоке (расчеты в разных потоках не смешиваются) и записываются в виде JSON
+// (таблица этапов) и в формате Chrome trace event (chrome://tracing, Perfetto)
+//-----------------------------------------------------------------------
+struct TTraceEvent
+{
+    string name;
+    unsigned thread;    // Номер потока
+    double start;       // Начало (с от запуска процесса)
+    double wall;        // Длительность (с)
+    double cpu;         // Процессорное время процесса (с), включая все потоки этапа
+    size_t peak_rss;    // Пиковый объем резидентной памяти процесса по окончании этапа (байт)
+    size_t count;       // Количество обработанных элементов
+    array<int64_t, TPerfCounters::Count> counters;  // Аппаратные счетчики этапа (-1 - не измерялись)
+};
+
+class TTrace
+{
+private:
+    static inline const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+    static inline atomic<unsigned> threads{0};
+    static inline thread_local vector<TTraceEvent> events;
+    static inline thread_local unsigned thread_no = threads++;
+    // Измерение аппаратных счетчиков в этапах текущего потока
+    static inline thread_local bool is_counters = false;
+    static string escape(const string &str)
+    {
+        string ret;
+
+        for (auto c: str)
+            if (c == '"' or c == '\\')
+                ret += string("\\") + c;
+            else if ((unsigned char)c >= 0x20)
+                ret += c;
+        return ret;
+    }
+    // Значения измеренных счетчиков в виде пар "имя": значение
+    static string counters(const TTraceEvent &event)
+    {
+        string ret;
+
+        for (auto i = 0; i < TPerfCounters::Count; i++)
+            if (event.counters[i] >= 0)
+                ret += ", \"" + string(TPerfCounters::name(i)) + "\": " + to_string(event.counters[i]);
+        return ret;
+    }
+public:
+    // Время от запуска процесса (с)
+    static double wall_time(void) noexcept
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - origin).count();
+    }
+    // Процессорное время процесса (с)
+    static double cpu_time(void) noexcept
+    {
+#ifndef _WIN32
+        rusage usage;
+
+        getrusage(RUSAGE_SELF, &usage);
+        return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0E-6;
+#else
+        return double(clock()) / CLOCKS_PER_SEC;
+#endif
+    }
+    // Пиковый объем резидентной памяти процесса (байт; 0 - не поддерживается)
+    static size_t peak_rss(void) noexcept
+    {
+#ifndef _WIN32
+        rusage usage;
+
+        getrusage(RUSAGE_SELF, &usage);
+    #ifdef __APPLE__
+        return size_t(usage.ru_maxrss);
+    #else
+        return size_t(usage.ru_maxrss) * 1024;
+    #endif
+#else
+        return 0;
+#endif
+    }
+    static void add(TTraceEvent event)
+    {
+        event.thread = thread_no;
+        events.push_back(move(event));
+    }
+    // События текущего потока
+    static const vector<TTraceEvent> &get_events(void) noexcept
+    {
+        return events;
+    }
+    static void clear(void) noexcept
+    {
+        events.clear();
+    }
+    static void set_counters(bool counters) noexcept
+    {
+        is_counters = counters;
+    }
+    static bool get_counters(void) noexcept
+    {
+        return is_counters;
+    }
+    // Таблица этапов текущего потока в формате JSON
+    static void write_metrics(const string &name, const string &program)
+    {
+        ofstream out(name);
+
+        if (not out.is_open())
+            throw TError(Message::ReadFile);
+        out.precision(9);
+        out << "{\n  \"program\": \"" << escape(program) << "\",\n  \"phases\": [";
+        for (auto i = 0u; i < events.size(); i++)
+            out << (i ? "," : "") << "\n    { \"name\": \"" << escape(events[i].name) << "\", \"thread\": " << events[i].thread
+                << ", \"start\": " << events[i].start << ", \"wall\": " << events[i].wall << ", \"cpu\": " << events[i].cpu
+                << ", \"peak_rss\": " << events[i].peak_rss << ", \"count\": " << events[i].count << counters(events[i]) << " }";
+        out << "\n  ]\n}\n";
+        if (out.fail())
+            throw TError(Message::ReadFile);
+    }
+    // События текущего потока в формате Chrome trace event (время в мкс)
+    static void write_chrome(const string &name)
+    {
+        ofstream out(name);
+
+        if (not out.is_open())
+            throw TError(Message::ReadFile);
+        out << fixed;
+        out.precision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for (auto i = 0u; i < events.size(); i++)
+            out << (i ? "," : "") << "\n  {\"name\": \"" << escape(events[i].name) << "\", \"cat\": \"fems\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                << events[i].thread << ", \"ts\": " << events[i].start * 1.0E+6 << ", \"dur\": " << events[i].wall * 1.0E+6
+                << ", \"args\": {\"cpu\": " << events[i].cpu << ", \"peak_rss\": " << events[i].peak_rss << ", \"count\": " << events[i].count << counters(events[i]) << "}}";
+        out << "\n]}\n";
+        if (out.fail())
+            throw TError(Message::ReadFile);
+    }
+};
+
+//-----------------------------------------------------------------------
+// Этап расчета: событие записывается при выходе из области видимости
+//-----------------------------------------------------------------------
+class TTraceScope
+{
+private:
+    string name;
+    size_t count;
+    double start;
+    double cpu;
+    TPerfCounters perf;
+public:
+    TTraceScope(const string &n, size_t c = 0) : name{n}, count{c}, start{TTrace::wall_time()}, cpu{TTrace::cpu_time()}
+    {
+        if (TTrace::get_counters())
+            perf.start();
+    }
+    ~TTraceScope(void)
+    {
+        auto counters = perf.stop();
+
+        TTrace::add({ name, 0, start, TTrace::wall_time() - start, TTrace::cpu_time() - cpu, TTrace::peak_rss(), count, counters });
+    }
+    void set_count(size_t c) noexcept
+    {
+        count = c;
+    }
+};
+
+#endif // TRACE_H
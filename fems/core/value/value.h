@@ -54,15 +54,22 @@ private:
             cerr << "Unknown type of value!" << endl;
     }
 #endif
+    // Значения вектора; вектор из функций формы должен быть предварительно вычислен в точке (см. value)
+    const vector<double> &values(void) const
+    {
+        if (not get_if<Vector>(&val) or not get_if<vector<double>>(&get<Vector>(val)))
+            throw TError(Message::InvalidOperation);
+        return get<vector<double>>(get<Vector>(val));
+    }
 public:
-    static array<double, 3> x;
     TValue(double d = 0) noexcept : val{d}  {}
     TValue(const TValue &rhs) noexcept: val{rhs.val} {}
     TValue(const vector<double> &s) noexcept: val{s} {}
     TValue(const vector<T> &s) noexcept: val{s} {}
     TValue(const matrix<double> &s) noexcept: val{s} {}
     ~TValue(void) noexcept = default ;
-    TValue value(void) const noexcept
+    // Значение в точке x (вектор из функций формы заменяется их значениями)
+    TValue value(const array<double, 3> &x) const noexcept
     {
         vector<double> res;
 
@@ -97,7 +104,7 @@ public:
             throw TError(Message::AsScalar);
         return get<Scalar>(val);
     }
-    vector<double> asVector(void)
+    vector<double> asVector(const array<double, 3> &x)
     {
         vector<double> res;
 
@@ -154,27 +161,29 @@ public:
     }
     friend TValue var(const TValue &lhs, const TValue &rhs)
     {
-        TValue l{lhs.value()},
-               r{rhs.value()};
         matrix<double> res;
 
 #ifdef DEBUG
-        watch_val(l);
-        watch_val(r);
+        watch_val(lhs);
+        watch_val(rhs);
 #endif
         if (get_if<Vector>(&lhs.val) and get_if<Vector>(&rhs.val))
         {
-            res.resize(get<vector<double>>(get<Vector>(l.val)).size(), get<vector<double>>(get<Vector>(l.val)).size() + 1);
+            auto &l = lhs.values(),
+                 &r = rhs.values();
+
+            res.resize(l.size(), l.size() + 1);
             for (auto i = 0u; i < res.size1(); i++)
                 for (auto j = 0u; j < res.size1(); j++)
-                    res[i][j] = get<vector<double>>(get<Vector>(l.val))[i] * get<vector<double>>(get<Vector>(r.val))[j] +
-                                get<vector<double>>(get<Vector>(l.val))[j] * get<vector<double>>(get<Vector>(r.val))[i];
+                    res[i][j] = l[i] * r[j] + l[j] * r[i];
         }
         else if (get_if<Scalar>(&lhs.val) and get_if<Vector>(&rhs.val))
         {
-            res.resize(get<vector<double>>(get<Vector>(r.val)).size(), get<vector<double>>(get<Vector>(r.val)).size() + 1);
+            auto &r = rhs.values();
+
+            res.resize(r.size(), r.size() + 1);
             for (auto i = 0u; i < res.size1(); i++)
-                res[i][res.size1()] = get<double>(l.val) * get<vector<double>>(get<Vector>(r.val))[i];
+                res[i][res.size1()] = get<double>(lhs.val) * r[i];
         }
         else
             throw TError(Message::InvalidOperation);
@@ -219,7 +228,7 @@ public:
         if (get_if<Scalar>(&lhs.val) and get_if<Scalar>(&rhs.val))
             res.val = get<Scalar>(lhs.val) + get<Scalar>(rhs.val);
         else if (get_if<Vector>(&lhs.val) and get_if<Vector>(&rhs.val))
-            res.val = get<vector<double>>(get<Vector>(lhs.value().val)) + get<vector<double>>(get<Vector>(rhs.value().val));
+            res.val = lhs.values() + rhs.values();
         else if (get_if<Matrix>(&lhs.val) and get_if<Matrix>(&rhs.val))
             res.val = get<Matrix>(lhs.val) + get<Matrix>(rhs.val);
         else
@@ -236,7 +245,7 @@ public:
         if (get_if<double>(&lhs.val) and get_if<double>(&rhs.val))
             res.val = get<Scalar>(lhs.val) - get<Scalar>(rhs.val);
         else if (get_if<Vector>(&lhs.val) and get_if<Vector>(&rhs.val))
-            res.val = get<vector<double>>(get<Vector>(lhs.value().val)) - get<vector<double>>(get<Vector>(rhs.value().val));
+            res.val = lhs.values() - rhs.values();
         else if (get_if<Matrix>(&lhs.val) and get_if<Matrix>(&rhs.val))
             res.val = get<Matrix>(lhs.val) - get<Matrix>(rhs.val);
         else
@@ -252,7 +261,7 @@ public:
             if (get_if<Scalar>(&rhs.val))
                 res.val = get<Scalar>(lhs.val) * get<Scalar>(rhs.val);
             else if (get_if<Vector>(&rhs.val))
-                res.val = get<Scalar>(lhs.val) * get<vector<double>>(get<Vector>(rhs.value().val));
+                res.val = get<Scalar>(lhs.val) * rhs.values();
             else
                 res.val = get<Scalar>(lhs.val) * get<Matrix>(rhs.val);
         }
@@ -261,7 +270,7 @@ public:
             if (get_if<Scalar>(&lhs.val))
                 res.val = get<Scalar>(lhs.val) * get<Scalar>(rhs.val);
             else if (get_if<Vector>(&lhs.val))
-                res.val = get<vector<double>>(get<Vector>(lhs.value().val)) * get<Scalar>(rhs.val);
+                res.val = lhs.values() * get<Scalar>(rhs.val);
             else
                 res.val = get<Matrix>(lhs.val) * get<Scalar>(rhs.val);
         }
@@ -278,7 +287,7 @@ public:
         if (get_if<Scalar>(&lhs.val))
             res.val = get<Scalar>(lhs.val) / get<Scalar>(rhs.val);
         else if (get_if<Vector>(&lhs.val))
-            res.val = get<vector<double>>(get<Vector>(lhs.value().val)) / get<Scalar>(rhs.val);
+            res.val = lhs.values() / get<Scalar>(rhs.val);
         else
             res.val = get<Matrix>(lhs.val) / get<Scalar>(rhs.val);
         return res;
@@ -0,0 +1,79 @@
+#include <chrono>
+#include "mesh/generator.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Генерация регулярной сетки заданного размера и программы расчета для нее:
+//
+// fems-gen <fe1d2|fe2d3|fe2d4|fe3d4> nx [ny [nz]] [--length lx [ly [lz]]] [--perturb доля шага] [--seed n]
+//          [--binary] [--output имя]
+//
+// Результат - файл сетки <имя>.trpa (или <имя>.bmsh при --binary) и программа <имя>.prg
+//-----------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    TMeshGenerator generator;
+    array<size_t, 3> count{ 0, 0, 0 };
+    array<double, 3> length{ 1, 1, 1 };
+    double perturbation = 0;
+    uint64_t seed = 1;
+    bool is_binary = false;
+    string type,
+           name;
+    auto is_number = [&](int i) { return i < argc and argv[i][0] not_eq '-'; };
+
+    try
+    {
+        if (argc < 3)
+            throw TError(Message::Syntax);
+        type = argv[1];
+        for (auto i = 2, k = 0; i < argc; i++)
+        {
+            string arg = argv[i];
+
+            if (arg == "--length")
+                for (auto l = 0; l < 3 and is_number(i + 1); l++)
+                    length[size_t(l)] = stod(argv[++i]);
+            else if (arg == "--perturb" and i + 1 < argc)
+                perturbation = stod(argv[++i]);
+            else if (arg == "--seed" and i + 1 < argc)
+                seed = stoull(argv[++i]);
+            else if (arg == "--binary")
+                is_binary = true;
+            else if (arg == "--output" and i + 1 < argc)
+                name = argv[++i];
+            else if (arg[0] not_eq '-' and k < 3)
+                count[size_t(k++)] = stoull(arg);
+            else
+                throw TError(Message::Syntax);
+        }
+        if (name.empty())
+            name = type + "_" + to_string(count[0]) + (count[1] ? "x" + to_string(count[1]) : "") + (count[2] ? "x" + to_string(count[2]) : "");
+        generator.set_mesh(type, count, length);
+        generator.set_perturbation(perturbation, seed);
+
+        auto start = chrono::steady_clock::now();
+
+        generator.create();
+        cout << "Nodes: " << generator.get_nodes() << ", FE: " << generator.get_fe_count() << ", BE: " << generator.get_be_count() << endl;
+        if (is_binary)
+            generator.write_binary(name + ".bmsh");
+        else
+            generator.write_text(name + ".trpa");
+        generator.write_program(name + ".prg", name + (is_binary ? ".bmsh" : ".trpa"));
+        cout << "Mesh: " << name << (is_binary ? ".bmsh" : ".trpa") << ", program: " << name << ".prg, "
+             << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+    }
+    catch (TError &e)
+    {
+        cerr << e.say() << endl;
+        return 1;
+    }
+    catch (exception&)
+    {
+        cerr << say_message(Message::Syntax) << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+# Генератор регулярных сеток для тестирования производительности (см. gen.cpp)
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+TARGET = fems-gen
+
+include(../core/core.pri)
+
+SOURCES += \
+        gen.cpp
@@ -0,0 +1,6 @@
+# Библиотека FEM Solver для встраивания (TFEM, см. core/fems.h)
+TEMPLATE = lib
+CONFIG += staticlib
+TARGET = fems
+
+include(../core/core.pri)
@@ -1,18 +1,73 @@
-#include "solver/eigensolver.h"
-#include "fem/fem.h"
+#include <csignal>
+#include "fems.h"
+#include "service/service.h"
 
 using namespace std;
 
+static TService<TEigenSolver> *service = nullptr;
+
+static void stop_service(int)
+{
+    if (service)
+        service->stop();
+}
+
 int main(int argc, char **argv)
 {
     TFEM<TEigenSolver> fem;
+    size_t memory = size_t(1) << 30;
 
     try
     {
+        // Режим без индикаторов выполнения, ограничение числа рабочих потоков и объема памяти моделей
+        // параметрического расчета (Мб): fems [--quiet] [--threads n] [--memory n] ...
+        while (argc > 1 and (string(argv[1]) == "--quiet" or string(argv[1]) == "--threads" or string(argv[1]) == "--memory"))
+        {
+            if (string(argv[1]) == "--quiet")
+                TProgress::set_quiet(true);
+            else
+            {
+                if (argc < 3 or atoi(argv[2]) <= 0)
+                    throw TError(Message::Syntax);
+                if (string(argv[1]) == "--threads")
+                    TWorkers::set_count(unsigned(atoi(argv[2])));
+                else
+                    memory = size_t(atoi(argv[2])) << 20;
+                argv++;
+                argc--;
+            }
+            argv++;
+            argc--;
+        }
         if (argc < 2)
             throw TError(Message::NotSpecifiedProgram);
+        // Резидентный режим: fems --serve <сокет> [число потоков] [объем кэша, МБ]
+        if (string(argv[1]) == "--serve")
+        {
+            if (argc < 3)
+                throw TError(Message::NotSpecifiedProgram);
+            TService<TEigenSolver> server(argv[2], argc > 3 ? unsigned(atoi(argv[3])) : TWorkers::count(),
+                                          argc > 4 ? size_t(atol(argv[4])) << 20 : size_t(1) << 30);
+
+            service = &server;
+            signal(SIGINT, stop_service);
+            signal(SIGTERM, stop_service);
+            server.run();
+            service = nullptr;
+            return 0;
+        }
         fem.set_program(argv[1]);
-        fem.start();
+        // Параметрический расчет: директивы #sweep в программе и/или fems <программа> <параметры.qfpf> ...
+        if (argc > 2 or fem.get_sweep().size())
+        {
+            TSweep<TEigenSolver> sweep(fem, argv[1], TWorkers::count(), memory);
+
+            for (auto i = 2; i < argc; i++)
+                sweep.add_parameters(argv[i]);
+            sweep.start();
+        }
+        else
+            fem.start();
     }
     catch (TError &e)
     {
@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#ifndef _WIN32
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+#include "fems.h"
+#include "mesh/generator.h"
+#include "thread/workers.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------
+// Сильная и слабая масштабируемость полного расчета (TFEM::run, включая чтение сетки и запись результатов)
+// на сгенерированных задачах. Для каждого размера сетки и числа потоков расчет повторяется,
+// по каждому этапу трассировки (см. trace.h) берется медиана времени; ускорение и эффективность
+// отсчитываются от первого числа потоков в списке. При слабой масштабируемости число шагов сетки
+// по каждой оси растет как (потоки / первое число потоков)^(1 / размерность).
+// Число потоков (TWorkers::set_count) учитывает только запись результатов (сжатие полей .bres и части
+// .vtu - этап write); чтение двоичной сетки, формирование и разложение матрицы, учет граничных условий
+// и вычисление функций выполняются одним потоком (Pardiso - mkl_sequential). Поэтому ускорение и
+// эффективность выводятся только для этапов из threaded_phases, для остальных этапов и общего времени -
+// null ("threaded": false); время всех этапов сравнивается с baseline.
+// Каждый вариант (размер и число потоков) рассчитывается в отдельном дочернем процессе: пиковый объем
+// резидентной памяти (ru_maxrss) - максимум за время жизни процесса, и в общем процессе он включал бы
+// память всех предыдущих вариантов.
+// Результат - строка JSON на каждый этап, размер и число потоков; при сравнении с сохраненным
+// результатом (--baseline) регрессией считается рост времени этапа более чем на threshold
+//
+// fems-scale [--type fe3d4] [--sizes 8,16] [--threads 1,2,4] [--weak] [--repeat 3] [--save файл.json]
+//            [--baseline файл.json] [--threshold 0.1] [--min-time 0.01] [--dir каталог]
+//
+// Код возврата: 0 - успешно, 1 - ошибка, 2 - обнаружена регрессия
+//-----------------------------------------------------------------------
+struct TScaleRecord
+{
+    string phase;
+    size_t size;        // Заданный размер (при слабой масштабируемости - для первого числа потоков)
+    size_t steps;       // Фактическое число шагов сетки по оси
+    unsigned threads;
+    size_t elements;
+    double wall;
+    double cpu;
+    size_t peak_rss;
+    bool is_threaded;   // Время этапа зависит от числа потоков
+    double speedup;
+    double efficiency;
+};
+
+class TScale
+{
+private:
+    string type = "fe3d4";
+    vector<size_t> sizes{ 8, 16 };
+    vector<unsigned> threads{ 1, 2, 4 };
+    bool is_weak = false;
+    unsigned repeat = 3;
+    double threshold = 0.1;
+    // Этапы короче min_time при сравнении не учитываются (погрешность измерения)
+    double min_time = 0.01;
+    string dir;
+    vector<TScaleRecord> records;
+    // Этапы, использующие TWorkers::count() потоков
+    static inline const vector<string> threaded_phases{ "write" };
+    static double median(vector<double> v)
+    {
+        sort(v.begin(), v.end());
+        return v.empty() ? 0 : v[v.size() / 2];
+    }
+    // Значение поля key строки JSON (без кавычек)
+    static string field(const string &line, const string &key)
+    {
+        size_t pos = line.find("\"" + key + "\":"),
+               end;
+
+        if (pos == string::npos or (pos = line.find_first_not_of(" \t", pos + key.length() + 3)) == string::npos)
+            return "";
+        if (line[pos] == '"')
+            return (end = line.find('"', pos + 1)) == string::npos ? "" : line.substr(pos + 1, end - pos - 1);
+        end = line.find_first_of(",}", pos);
+        return line.substr(pos, end == string::npos ? string::npos : line.find_last_not_of(" \t", end - 1) - pos + 1);
+    }
+    string key(const string &phase, size_t size, unsigned t) const
+    {
+        return phase + " " + to_string(size) + " " + to_string(t);
+    }
+    unsigned dim(void) const
+    {
+        return type == "fe1d2" ? 1 : (type == "fe3d4" ? 3 : 2);
+    }
+    // Генерация задачи с n шагами по каждой оси (файлы <dir>/<type>_<n>.bmsh и .prg)
+    string create_problem(size_t n)
+    {
+        TMeshGenerator generator;
+        string name = (filesystem::path(dir) / (type + "_" + to_string(n))).string();
+
+        if (not filesystem::exists(name + ".prg"))
+        {
+            generator.set_mesh(type, { n, n, n }, { 1, 1, 1 });
+            generator.create();
+            generator.write_binary(name + ".bmsh");
+            generator.write_program(name + ".prg", filesystem::path(name + ".bmsh").filename().string());
+        }
+        return name + ".prg";
+    }
+    // Расчет одного варианта: медианы этапов по повторениям
+    void measure(size_t size, size_t n, unsigned t)
+    {
+        string prg = create_problem(n);
+        map<string, vector<double>> wall,
+                                    cpu;
+        map<string, size_t> rss;
+        size_t elements = 0;
+
+        TWorkers::set_count(t);
+        for (auto i = 0u; i < repeat; i++)
+        {
+            TFEM<TEigenSolver> fem;
+            double start = TTrace::wall_time(),
+                   start_cpu = TTrace::cpu_time();
+
+            fem.set_program(prg);
+            fem.start();
+            wall["total"].push_back(TTrace::wall_time() - start);
+            cpu["total"].push_back(TTrace::cpu_time() - start_cpu);
+            for (auto &it: TTrace::get_events())
+            {
+                wall[it.name].push_back(it.wall);
+                cpu[it.name].push_back(it.cpu);
+                rss[it.name] = max(rss[it.name], it.peak_rss);
+                rss["total"] = max(rss["total"], it.peak_rss);
+            }
+            elements = fem.get_mesh().get_fe_count();
+        }
+        TWorkers::set_count(0);
+        for (auto &[phase, time]: wall)
+            records.push_back({ phase, size, n, t, elements, median(time), median(cpu[phase]), rss[phase],
+                                find(threaded_phases.begin(), threaded_phases.end(), phase) not_eq threaded_phases.end(), 0, 0 });
+    }
+    // Расчет варианта в дочернем процессе; записи этапов передаются через канал строками
+    // "этап размер шаги потоки элементы время процессор память признак", ошибка - строкой "error код"
+    void isolate(size_t size, size_t n, unsigned t)
+    {
+#ifndef _WIN32
+        int fd[2],
+            status = 0;
+        pid_t pid;
+        string text,
+               line;
+        char buf[4096];
+        ssize_t len;
+
+        if (pipe(fd) not_eq 0)
+            throw TError(Message::InternalError);
+        if ((pid = fork()) < 0)
+        {
+            ::close(fd[0]);
+            ::close(fd[1]);
+            throw TError(Message::InternalError);
+        }
+        if (pid == 0)
+        {
+            stringstream ss;
+
+            ::close(fd[0]);
+            ss.precision(17);
+            try
+            {
+                records.clear();
+                measure(size, n, t);
+                for (auto &it: records)
+                    ss << it.phase << ' ' << it.size << ' ' << it.steps << ' ' << it.threads << ' ' << it.elements << ' ' << it.wall << ' '
+                       << it.cpu << ' ' << it.peak_rss << ' ' << it.is_threaded << '\n';
+            }
+            catch (TError &e)
+            {
+                ss.str("");
+                ss << "error " << int(e.get_message()) << '\n';
+            }
+            catch (...)
+            {
+                ss.str("");
+                ss << "error " << int(Message::InternalError) << '\n';
+            }
+            text = ss.str();
+            for (size_t pos = 0; pos < text.length(); pos += size_t(len))
+                if ((len = ::write(fd[1], text.data() + pos, text.length() - pos)) <= 0)
+                    break;
+            ::close(fd[1]);
+            _exit(0);
+        }
+        ::close(fd[1]);
+        while ((len = ::read(fd[0], buf, sizeof(buf))) > 0)
+            text.append(buf, size_t(len));
+        ::close(fd[0]);
+        if (waitpid(pid, &status, 0) not_eq pid or not WIFEXITED(status) or WEXITSTATUS(status) not_eq 0)
+            throw TError(Message::InternalError);
+
+        stringstream ss(text);
+
+        while (getline(ss, line))
+        {
+            stringstream in(line);
+            TScaleRecord r{};
+            int code;
+
+            if (line.compare(0, 6, "error ") == 0)
+            {
+                in.ignore(6) >> code;
+                throw TError(Message(code));
+            }
+            if (not (in >> r.phase >> r.size >> r.steps >> r.threads >> r.elements >> r.wall >> r.cpu >> r.peak_rss >> r.is_threaded))
+                throw TError(Message::InternalError);
+            records.push_back(r);
+        }
+#else
+        measure(size, n, t);
+#endif
+    }
+    // Ускорение и эффективность относительно первого числа потоков
+    void evaluate(void)
+    {
+        for (auto &it: records)
+        {
+            auto base = find_if(records.begin(), records.end(), [&](auto &r) { return r.phase == it.phase and r.size == it.size and r.threads == threads.front(); });
+            double ratio = double(it.threads) / double(threads.front());
+
+            if (not it.is_threaded or base == records.end() or it.wall <= 0)
+                continue;
+            // Сильная: T1 / Tp и T1 / (p * Tp); слабая: эффективность T1 / Tp, масштабированное ускорение p * T1 / Tp
+            it.efficiency = is_weak ? base->wall / it.wall : base->wall / (ratio * it.wall);
+            it.speedup = is_weak ? ratio * base->wall / it.wall : base->wall / it.wall;
+        }
+    }
+    void write(ostream &out)
+    {
+        out.precision(6);
+        for (auto &it: records)
+            out << "{ \"type\": \"" << type << "\", \"mode\": \"" << (is_weak ? "weak" : "strong") << "\", \"phase\": \"" << it.phase
+                << "\", \"size\": " << it.size << ", \"steps\": " << it.steps << ", \"threads\": " << it.threads << ", \"elements\": " << it.elements
+                << ", \"wall\": " << it.wall << ", \"cpu\": " << it.cpu << ", \"peak_rss\": " << it.peak_rss
+                << ", \"threaded\": " << (it.is_threaded ? "true" : "false")
+                << ", \"speedup\": " << (it.is_threaded ? to_string(it.speedup) : "null")
+                << ", \"efficiency\": " << (it.is_threaded ? to_string(it.efficiency) : "null") << " }" << endl;
+    }
+public:
+    TScale(void) noexcept {}
+    ~TScale(void) noexcept = default;
+    void set_type(const string &t)
+    {
+        TMeshGenerator().set_mesh(t, { 1, 1, 1 });
+        type = t;
+    }
+    void set_sizes(const vector<size_t> &s)
+    {
+        sizes = s;
+    }
+    void set_threads(const vector<unsigned> &t)
+    {
+        threads = t;
+    }
+    void set_weak(bool w) noexcept
+    {
+        is_weak = w;
+    }
+    void set_repeat(unsigned r) noexcept
+    {
+        repeat = max(1u, r);
+    }
+    void set_threshold(double t, double m) noexcept
+    {
+        threshold = t;
+        min_time = m;
+    }
+    void set_dir(const string &d)
+    {
+        dir = d;
+    }
+    void run(ostream &out)
+    {
+        records.clear();
+        filesystem::create_directories(dir);
+        for (auto size: sizes)
+            for (auto t: threads)
+                isolate(size, is_weak ? size_t(llround(double(size) * pow(double(t) / double(threads.front()), 1.0 / dim()))) : size, t);
+        evaluate();
+        write(out);
+    }
+    void save(const string &name)
+    {
+        ofstream out(name);
+
+        if (not out.is_open())
+            throw TError(Message::ReadFile);
+        write(out);
+        if (out.fail())
+            throw TError(Message::ReadFile);
+    }
+    // Сравнение с сохраненным результатом; возвращает количество этапов с регрессией
+    unsigned compare(const string &name, ostream &out)
+    {
+        ifstream in(name);
+        map<string, double> baseline;
+        string line;
+        unsigned ret = 0;
+
+        if (not in.is_open())
+            throw TError(Message::ReadFile);
+        while (getline(in, line))
+            if (field(line, "type") == type and field(line, "mode") == (is_weak ? "weak" : "strong"))
+                baseline[key(field(line, "phase"), stoull(field(line, "size")), unsigned(stoul(field(line, "threads"))))] = stod(field(line, "wall"));
+        for (auto &it: records)
+        {
+            auto base = baseline.find(key(it.phase, it.size, it.threads));
+
+            if (base == baseline.end() or max(base->second, it.wall) < min_time or it.wall <= base->second * (1 + threshold))
+                continue;
+            out << "Regression: " << it.phase << ", size " << it.size << ", threads " << it.threads << ": " << base->second << " s -> " << it.wall
+                << " s (+" << 100 * (it.wall / base->second - 1) << "%)" << endl;
+            ret++;
+        }
+        return ret;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    // Сообщения модели не должны смешиваться с результатами замеров
+    ostream out(cout.rdbuf());
+    TScale scale;
+    string baseline,
+           save,
+           dir = (filesystem::temp_directory_path() / ("fems-scale-" + to_string(chrono::steady_clock::now().time_since_epoch().count()))).string();
+    double threshold = 0.1,
+           min_time = 0.01;
+    bool is_temp = true;
+    unsigned regressions = 0;
+    auto split = [](const string &str)
+    {
+        stringstream ss(str);
+        string val;
+        vector<size_t> ret;
+
+        while (getline(ss, val, ','))
+            ret.push_back(size_t(max(1, stoi(val))));
+        return ret;
+    };
+
+    TProgress::set_quiet(true);
+    cout.rdbuf(nullptr);
+    try
+    {
+        for (auto i = 1; i < argc; i++)
+        {
+            string arg = argv[i];
+
+            if (arg == "--weak")
+            {
+                scale.set_weak(true);
+                continue;
+            }
+            if (i + 1 == argc)
+                throw TError(Message::Syntax);
+            if (arg == "--type")
+                scale.set_type(argv[++i]);
+            else if (arg == "--sizes")
+                scale.set_sizes(split(argv[++i]));
+            else if (arg == "--threads")
+            {
+                auto t = split(argv[++i]);
+
+                scale.set_threads(vector<unsigned>(t.begin(), t.end()));
+            }
+            else if (arg == "--repeat")
+                scale.set_repeat(unsigned(max(1, stoi(argv[++i]))));
+            else if (arg == "--save")
+                save = argv[++i];
+            else if (arg == "--baseline")
+                baseline = argv[++i];
+            else if (arg == "--threshold")
+                threshold = stod(argv[++i]);
+            else if (arg == "--min-time")
+                min_time = stod(argv[++i]);
+            else if (arg == "--dir")
+            {
+                dir = argv[++i];
+                is_temp = false;
+            }
+            else
+                throw TError(Message::Syntax);
+        }
+        scale.set_threshold(threshold, min_time);
+        scale.set_dir(dir);
+        scale.run(out);
+        if (save.length())
+            scale.save(save);
+        if (baseline.length())
+            regressions = scale.compare(baseline, cerr);
+        if (is_temp)
+            filesystem::remove_all(dir);
+    }
+    catch (TError &e)
+    {
+        cerr << e.say() << endl;
+        return 1;
+    }
+    catch (exception&)
+    {
+        cerr << say_message(Message::Syntax) << endl;
+        return 1;
+    }
+    return regressions ? 2 : 0;
+}
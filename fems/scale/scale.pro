@@ -0,0 +1,11 @@
+# Замеры масштабируемости полного расчета FEM Solver (см. scale.cpp)
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+TARGET = fems-scale
+
+include(../core/core.pri)
+
+SOURCES += \
+        scale.cpp